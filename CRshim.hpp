@@ -32,8 +32,13 @@
  * It is a self-contained, 'header-only' library.
  */
 
+#include <charconv>
+#include <map>
+#include <optional>
+#include <string_view>
 #include <utility>
 #include "syncps/syncps.hpp"
+#include "local-link.hpp"
 
 using namespace syncps;
 using namespace ndn;
@@ -106,61 +111,269 @@ struct Reply : public Publication {
     }
 };
 
+/*
+ * Optional command parameters. They're carried in the command's Content as
+ * 'key=value' lines (commands without options have an empty Content).
+ * Current keys:
+ *   dl  ms after the command's timestamp that the issuer will wait for replies
+ *   tr  if non-zero, NOD appends its trace spans to the reply (see TraceSpans)
+ *   at  wall clock instant (us since the Unix epoch) at which NODs should run
+ *       the probe. NOD appends the instant and when it actually ran the probe
+ *       to the reply (see ReplyTrailer::at)
+ */
+struct CmdOpts : std::map<std::string, std::string> {
+    using std::map<std::string, std::string>::map;
+
+    static CmdOpts decode(const Block& content)
+    {
+        CmdOpts o;
+        std::string_view v((const char*)content.value(), content.value_size());
+        while (! v.empty()) {
+            auto e = v.find('\n');
+            auto l = v.substr(0, e);
+            if (auto eq = l.find('='); eq != l.npos) {
+                o.emplace(l.substr(0, eq), l.substr(eq + 1));
+            }
+            if (e == v.npos) {
+                break;
+            }
+            v.remove_prefix(e + 1);
+        }
+        return o;
+    }
+    std::string encode() const
+    {
+        std::string s;
+        for (const auto& [k, v] : *this) {
+            s += k + "=" + v + "\n";
+        }
+        return s;
+    }
+    // integer value of option 'k' or 'dflt' if it's absent or malformed
+    int64_t num(const std::string& k, int64_t dflt = 0) const
+    {
+        auto o = find(k);
+        int64_t v;
+        if (o == end() || std::from_chars(o->second.data(),
+                o->second.data() + o->second.size(), v).ec != std::errc()) {
+            return dflt;
+        }
+        return v;
+    }
+};
+
+/*
+ * Reply trailer: items a NOD appends to a reply's Content, after the probe
+ * output, when the command asks for them. Its layout is
+ *     item* itemBytes(2, little-endian) 'D' 'T'
+ * where each item is type(1) length(1) value(length).
+ */
+struct ReplyTrailer : std::map<uint8_t, std::string> {
+    // 'at' is the requested then the actual probe start time (each int64 us
+    // since the Unix epoch, little-endian)
+    enum : uint8_t { trace = 1, at = 2 };
+    static constexpr size_t fixedSize = 4;
+
+    static std::string encodeAt(int64_t requested, int64_t actual)
+    {
+        std::string s;
+        for (auto v : {requested, actual}) {
+            for (int i = 0; i < 8; ++i) s += char(uint64_t(v) >> (8 * i));
+        }
+        return s;
+    }
+    static std::optional<std::pair<int64_t, int64_t>> decodeAt(std::string_view s)
+    {
+        if (s.size() != 16) {
+            return std::nullopt;
+        }
+        auto i64 = [&s](size_t o) {
+            uint64_t v{};
+            for (int i = 7; i >= 0; --i) v = v << 8 | uint8_t(s[o + i]);
+            return int64_t(v);
+        };
+        return std::pair{i64(0), i64(8)};
+    }
+
+    void appendTo(std::string& content) const
+    {
+        size_t n{};
+        for (const auto& [t, v] : *this) {
+            content += char(t);
+            content += char(v.size());
+            content += v;
+            n += 2 + v.size();
+        }
+        content += char(n & 0xff);
+        content += char(n >> 8);
+        content += "DT";
+    }
+
+    /*
+     * Split a reply's content into probe output and trailer. Content
+     * without a (well-formed) trailer is all output.
+     */
+    static std::pair<std::string_view, ReplyTrailer> split(const Block& content)
+    {
+        std::string_view c((const char*)content.value(), content.value_size());
+        ReplyTrailer t;
+        auto sz = c.size();
+        if (sz < fixedSize || c.substr(sz - 2) != "DT") {
+            return {c, t};
+        }
+        size_t n = uint8_t(c[sz - 4]) | uint8_t(c[sz - 3]) << 8;
+        if (n + fixedSize > sz) {
+            return {c, t};
+        }
+        auto items = c.substr(sz - fixedSize - n, n);
+        while (items.size() >= 2 && size_t(uint8_t(items[1])) + 2 <= items.size()) {
+            size_t len = uint8_t(items[1]);
+            t.emplace(uint8_t(items[0]), items.substr(2, len));
+            items.remove_prefix(2 + len);
+        }
+        return {c.substr(0, sz - fixedSize - n), t};
+    }
+};
+
+/*
+ * Where a NOD spent its time handling a traced command. Each is the
+ * offset, in microseconds, from when the NOD received the command
+ * except 'fetch' which is the time the probe spent waiting on NFD.
+ */
+struct TraceSpans {
+    uint32_t dispatch{};    // taken off the NOD's queue
+    uint32_t start{};       // probe started
+    uint32_t fetch{};       // (duration) of NFD management fetches
+    uint32_t end{};         // probe finished (including formatting)
+    uint32_t publish{};     // reply handed to sync
+
+    std::string encode() const
+    {
+        std::string s;
+        for (auto v : {dispatch, start, fetch, end, publish}) {
+            for (int i = 0; i < 4; ++i) s += char(v >> (8 * i));
+        }
+        return s;
+    }
+    static std::optional<TraceSpans> decode(std::string_view s)
+    {
+        if (s.size() != 20) {
+            return std::nullopt;
+        }
+        auto u32 = [&s](size_t o) {
+            return uint32_t(uint8_t(s[o])) | uint32_t(uint8_t(s[o + 1])) << 8 |
+                   uint32_t(uint8_t(s[o + 2])) << 16 | uint32_t(uint8_t(s[o + 3])) << 24;
+        };
+        return TraceSpans{u32(0), u32(4), u32(8), u32(12), u32(16)};
+    }
+};
+
 class CRshim;
 
 using rpHndlr = std::function<void(const Reply&, CRshim&)>;
-using cmHndlr = std::function<void(RName&&, CRshim&)>;
+using cmHndlr = std::function<void(RName&&, CmdOpts&&, CRshim&)>;
 using Timer = ndn::scheduler::ScopedEventId;
 using TimerCb = std::function<void()>;
 
 #define LOG(x)
 
+/*
+ * A client shim for target 'local' uses the NOD's shared memory local link
+ * (see local-link.hpp) when the NOD offers one, otherwise (or if a command
+ * doesn't fit the link) sync. Its sync session is only set up on first use
+ * so a client that only uses the link never touches the forwarder.
+ */
 class CRshim
 {
   public:
     CRshim(Face& face, const std::string& target) :
-        m_face(face), m_sync(m_face, targetToPrefix(target), isExpired, filterPubs),
-        m_topic{topicName(target)}
+        m_face(face), m_target{target}, m_topic{topicName(target)}
     {}
     CRshim(const std::string& target) :
-        CRshim(*new Face(), target) {}
+        CRshim(*new Face(), target)
+    {
+        connectLocal();
+    }
     CRshim(const CRshim& s1, const std::string& target) :
-        CRshim(s1.m_face, target) {}
+        CRshim(s1.m_face, target)
+    {
+        connectLocal();
+    }
 
     void run() { m_face.processEvents(); }
     auto prefix() const { return m_topic; }
+    const SyncPubsub& pubsub() { return sync(); }
+    bool isLocalLink() const { return m_local != nullptr; }
+    boost::asio::io_service& ioService() { return m_face.getIoService(); }
+    Face& face() { return m_face; }
 
     /* command/reply client methods */
 
     /*
      * build a command for the probeType (passed in as a string)
      * with the optional probeArgs (passed in as a string)
+     * and command options.
      * Creates an NDN name according to DNMP spec for command
     */
-    Publication buildCmd(const std::string& s, const std::string& a = "")
+    Publication buildCmd(const std::string& s, const std::string& a = "",
+                         const CmdOpts& o = {})
     {
         Name cmd(prefix());
         cmd.append(Name::Component(s)).append(Name::Component(a))
            .append(myPID()).appendTimestamp();
-        return Publication(cmd);
+        Publication c(cmd);
+        if (! o.empty()) {
+            auto e = o.encode();
+            c.setContent((const uint8_t*)e.data(), e.size());
+        }
+        return c;
     }
 
     /*
      * subscribe to a topic for the expected reply, then publish the command
     */
     CRshim& issueCmd(const std::string& ptype, const std::string& pargs,
-        const rpHndlr& rh)
+        const rpHndlr& rh, const CmdOpts& opts = {})
     { 
-        auto cmd(buildCmd(ptype, pargs));
-        m_sync.subscribeTo(expectedReply(cmd), 
-            [this,rh](auto r){ rh((const Reply&)(r),*this); });
-        m_sync.publish(std::move(cmd));
+        sendCmd(ptype, pargs, rh, opts);
         return *this;
     }
 
-    void doCommand(const std::string& ptype, const std::string& pargs, const rpHndlr& rh)
+    /*
+     * issueCmd that returns the command's reply topic so a long-lived client
+     * can stop listening for the replies (with endCmd) when it's done.
+     */
+    RName sendCmd(const std::string& ptype, const std::string& pargs,
+                  const rpHndlr& rh, const CmdOpts& opts = {})
     {
-        issueCmd(ptype, pargs, rh);
+        auto cmd(buildCmd(ptype, pargs, opts));
+        auto topic = expectedReply(cmd);
+        if (m_local && ! m_local->isDead()) {
+            // (the NOD answers on the link if we're attached, however
+            // the command got to it)
+            m_localReplies[topic] = rh;
+            const auto& c = cmd.getContent();
+            if (m_local->send(cmd.getName(), {(const char*)c.value(), c.value_size()})) {
+                return topic;
+            }
+        }
+        sync().subscribeTo(topic, [this,rh](auto r){ rh((const Reply&)(r),*this); });
+        sync().publish(std::move(cmd));
+        return topic;
+    }
+
+    void endCmd(const RName& topic)
+    {
+        m_localReplies.erase(topic);
+        if (m_sync) {
+            m_sync->unsubscribe(topic);
+        }
+    }
+
+    void doCommand(const std::string& ptype, const std::string& pargs,
+                   const rpHndlr& rh, const CmdOpts& opts = {})
+    {
+        issueCmd(ptype, pargs, rh, opts);
         run();
     }
 
@@ -171,17 +384,69 @@ class CRshim
      */
     CRshim& waitForCmd(const cmHndlr& ch)
     {
-        m_sync.subscribeTo(prefix().getSubName(0, prefix().size() - 3),
-                           [this, ch](auto c) { ch(expectedReply(c), *this); });
+        m_cmdHndlr = ch;
+        sync().subscribeTo(prefix().getSubName(0, prefix().size() - 3),
+                           [this, ch](auto c) {
+                               ch(expectedReply(c), CmdOpts::decode(c.getContent()), *this);
+                           });
+        return *this;
+    }
+
+    /*
+     * Also take commands from clients on this host over local links
+     * (after waitForCmd). Replies to attached clients go back on their link.
+     */
+    CRshim& serveLocal(const std::string& path = localSockPath())
+    {
+        // (a client's ID is what myPID() gives in that process)
+        m_localSrv = std::make_unique<LocalServer>(ioService(), path,
+                        [](pid_t pid) { return addHostname("_", "pid" + std::to_string(pid)); },
+                        [this](std::string_view id, uid_t uid, const Name& n,
+                               std::string_view content) {
+                            // a client can only send its own commands, as
+                            // itself (its Id is what myID() gives it)
+                            if (! m_cmdHndlr || n.size() <= 8 ||
+                                    ! prefix().getSubName(0, prefix().size() - 3).isPrefixOf(n)) {
+                                return;
+                            }
+                            const auto& o = ((const RName&)n)["origin"];
+                            if (std::string_view((const char*)o.value(), o.value_size()) != id ||
+                                    ((const RName&)n).str("Id") != "uid" + std::to_string(uid)) {
+                                return;
+                            }
+                            Publication c(n);
+                            c.setContent((const uint8_t*)content.data(), content.size());
+                            m_cmdHndlr(expectedReply(c), CmdOpts::decode(c.getContent()), *this);
+                        });
         return *this;
     }
 
     void sendReply(Name& n, std::string&& rv)
     {
-        // append nod id & timestamp to reply name then publish reply
-        n.append(Name::Component(myPID())).appendTimestamp();
-        Publication r(n);
-        m_sync.publish(std::move(r.setContent((const uint8_t*)(rv.data()), rv.size())));
+        auto r = makeReply(n, rv);
+        if (! sendLocal(r)) {
+            sync().publish(std::move(r));
+        }
+    }
+
+    /*
+     * Replies can also be queued then published together by flushReplies()
+     * so a burst of them costs sync one sync interest and one pass over
+     * pending peer interests rather than one per reply.
+     */
+    void queueReply(Name& n, std::string&& rv)
+    {
+        if (auto r = makeReply(n, rv); ! sendLocal(r)) {
+            m_replies.push_back(std::move(r));
+        }
+    }
+    size_t queuedReplies() const { return m_replies.size(); }
+    void flushReplies()
+    {
+        if (! m_replies.empty()) {
+            sync().publishMany(std::move(m_replies));
+            m_replies.clear();
+        }
     }
 
     /*
@@ -215,10 +480,104 @@ class CRshim
     }
 
     Timer schedule(ndn::time::nanoseconds d, const TimerCb& cb) {
-        return m_sync.schedule(d, cb);
+        return m_sched.schedule(d, cb);
+    }
+
+    /*
+     * Publications other than commands and replies exchanged between
+     * members of this shim's sync group (e.g., NOD-to-NOD echoes).
+     * 'publish' appends the timestamp that bounds the pub's lifetime.
+     */
+    void publish(Name n, std::string_view content = {})
+    {
+        Publication p(n.appendTimestamp());
+        p.setContent((const uint8_t*)content.data(), content.size());
+        sync().publish(std::move(p));
+    }
+    CRshim& subscribe(const Name& topic, UpdateCb&& cb)
+    {
+        sync().subscribeTo(topic, std::move(cb));
+        return *this;
+    }
+    CRshim& unsubscribe(const Name& topic)
+    {
+        sync().unsubscribe(topic);
+        return *this;
     }
 
   protected:
+    SyncPubsub& sync()
+    {
+        if (! m_sync) {
+            m_sync.emplace(m_face, targetToPrefix(m_target), isExpired, filterPubs);
+            // $DNMP_SYNC_PROTO=riblt has our sync interests use rateless
+            // iblts (peers answer either kind)
+            if (auto p = std::getenv("DNMP_SYNC_PROTO"); p && std::string_view(p) == "riblt") {
+                m_sync->setSyncProto(SyncProto::riblt);
+            }
+        }
+        return *m_sync;
+    }
+
+    // send reply 'r' on the local link of the client that issued its
+    // command, if it's attached to us
+    bool sendLocal(const Publication& r)
+    {
+        const auto& n = (const RName&)r.getName();
+        if (! m_localSrv || n.size() <= 8) {
+            return false;
+        }
+        const auto& o = n["origin"];
+        const auto& c = r.getContent();
+        return m_localSrv->send({(const char*)o.value(), o.value_size()}, n,
+                                {(const char*)c.value(), c.value_size()});
+    }
+
+    // a client of the 'local' target uses the NOD's link if there is one
+    void connectLocal()
+    {
+        if (m_target != "local") {
+            return;
+        }
+        m_local = LocalLink::connect(ioService(), localSockPath(),
+                                     [this](const auto& n, auto c) { localReply(n, c); });
+        if (m_local) {
+            m_local->onDead([this] { localLinkDown(); });
+        }
+    }
+
+    // the NOD closed our link (it went away or we fell too far behind
+    // reading replies) so listen for the outstanding ones on sync
+    void localLinkDown()
+    {
+        for (const auto& [topic, rh] : m_localReplies) {
+            sync().subscribeTo(topic, [this,rh=rh](auto r){ rh((const Reply&)(r),*this); });
+        }
+        m_localReplies.clear();
+    }
+
+    // a reply that arrived on our local link
+    void localReply(const Name& n, std::string_view content)
+    {
+        auto h = m_localReplies.lower_bound(n);
+        if ((h == m_localReplies.end() || ! h->first.isPrefixOf(n)) &&
+                (h == m_localReplies.begin() || ! (--h)->first.isPrefixOf(n))) {
+            return;
+        }
+        Reply r(n);
+        r.setContent((const uint8_t*)content.data(), content.size());
+        h->second(r, *this);
+    }
+
+    // append nod id & timestamp to reply name then make the reply
+    static Publication makeReply(Name& n, const std::string& rv)
+    {
+        n.append(Name::Component(myPID())).appendTimestamp();
+        Publication r(n);
+        r.setContent((const uint8_t*)(rv.data()), rv.size());
+        return r;
+    }
+
     static inline const FilterPubsCb filterPubs =
         [](auto& pOurs, auto& pOthers) mutable {
             // Only reply if at least one of the pubs is ours. Order the
@@ -227,7 +586,7 @@ class CRshim
             if (pOurs.empty()) {
                 return pOurs;
             }
-            const auto cmp = [](const auto p1, const auto p2) {
+            const auto cmp = [](const auto& p1, const auto& p2) {
                 return p1->getName()[-1].toTimestamp() >
                        p2->getName()[-1].toTimestamp();
             };
@@ -240,7 +599,7 @@ class CRshim
             }
             return pOurs;
         };
-    static inline const IsExpiredCb isExpired = [](auto p) {
+    static inline const IsExpiredCb isExpired = [](const auto& p) {
         auto dt = ndn::time::system_clock::now() - p.getName()[-1].toTimestamp();
         return dt >= maxPubLifetime+maxClockSkew || dt <= -maxClockSkew;
     };
@@ -292,8 +651,15 @@ class CRshim
     // -- end of place holders --
   private:
     Face& m_face;
-    SyncPubsub m_sync;
+    std::string m_target;
+    std::optional<SyncPubsub> m_sync{};     // (see sync())
+    ndn::Scheduler m_sched{m_face.getIoService()};
     Name m_topic;     // full name of the topic
+    std::vector<Publication> m_replies{};   // queued by queueReply()
+    cmHndlr m_cmdHndlr{};
+    std::unique_ptr<LocalLink> m_local{};   // client's link to the NOD
+    std::map<Name, rpHndlr> m_localReplies{};
+    std::unique_ptr<LocalServer> m_localSrv{};  // NOD's local link server
 };
 
 #endif // CRSHIM_CPP
@@ -0,0 +1,83 @@
+#ifndef AGENT_SOCK_HPP
+#define AGENT_SOCK_HPP
+/*
+ * agent-sock.hpp: where dnmpAgent listens and who may talk to it
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * dnmpAgent runs commands with its user's identity so only that user may
+ * reach it. Its socket is $DNMP_AGENT_SOCK, $XDG_RUNTIME_DIR/dnmp-agent.sock
+ * or /tmp/dnmp-agent-<uid>/agent.sock, and the socket's directory must
+ * belong to the user and not be writable by anyone else (so no one else can
+ * put a socket there first). Both ends also check that the kernel's
+ * credentials for the connection are the user's.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <cstdlib>
+#include <string>
+
+static inline std::string agentSockPath()
+{
+    if (auto p = std::getenv("DNMP_AGENT_SOCK"); p) {
+        return p;
+    }
+    if (auto d = std::getenv("XDG_RUNTIME_DIR"); d && *d) {
+        return std::string(d) + "/dnmp-agent.sock";
+    }
+    return "/tmp/dnmp-agent-" + std::to_string(getuid()) + "/agent.sock";
+}
+
+// true if 'path's directory is ours and no one else can write it. With
+// 'create' the directory is made (mode 0700) if it doesn't exist.
+static inline bool agentSockDirOk(const std::string& path, bool create = false)
+{
+    auto slash = path.rfind('/');
+    auto dir = slash == std::string::npos? std::string(".") :
+               slash == 0? std::string("/") : path.substr(0, slash);
+    if (create) {
+        ::mkdir(dir.c_str(), 0700);
+    }
+    struct stat st;
+    return ::lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == getuid() &&
+           (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// true if the process at the other end of unix socket 's' runs as our user
+static inline bool peerIsUs(int s)
+{
+#if defined(__linux__)
+    ucred cred;
+    socklen_t len = sizeof(cred);
+    return ::getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+           len == sizeof(cred) && cred.uid == getuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return ::getpeereid(s, &uid, &gid) == 0 && uid == getuid();
+#endif
+}
+
+#endif // AGENT_SOCK_HPP
@@ -150,7 +150,10 @@ int main(int argc, char* argv[])
         // make a CRshim with this target
         CRshim s(target);
         timer = s.schedule(interval, []() { bhFinish(); });
-        s.doCommand("NFDRIB", pargs, blackholeReply);
+        // replies that arrive after the first wait are of no use
+        CmdOpts opts{{"dl", std::to_string(
+                boost::chrono::duration_cast<boost::chrono::milliseconds>(interval).count())}};
+        s.doCommand("NFDRIB", pargs, blackholeReply, opts);
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
     }
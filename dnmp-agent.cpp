@@ -0,0 +1,290 @@
+/*
+ * dnmp-agent.cpp: resident DNMP client agent
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * dnmpAgent keeps a warm CRshim (sync session, registered prefix, local
+ * link) for each target it's used with and runs commands for dnmpCLI (see
+ * dnmp-cli.cpp) so a scripted command doesn't pay for a Face, KeyChain and
+ * prefix registration each time.
+ *
+ * A CLI of the same user connects to the agent's unix socket (see
+ * agent-sock.hpp) and sends one request line of tab-separated key=value
+ * fields:
+ *   t  target (default local)       p  probe type (required)
+ *   a  probe args                   c  count of commands (default 1)
+ *   i  ms between commands (1000)   w  ms to wait for replies (1000)
+ * The agent streams back each reply as it arrives (the probe output then a
+ * timing line, as genericCLI prints them) and closes the connection when
+ * it stops listening for replies.
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+
+#include "CRshim.hpp"
+#include "agent-sock.hpp"
+
+using stream = boost::asio::local::stream_protocol;
+
+static int debug{};
+
+/*
+ * The agent's shims, by target. The first is made with its own Face (and
+ * is 'local' so it gets the NOD's local link if there is one) and the rest
+ * share it.
+ */
+static std::map<std::string, std::unique_ptr<CRshim>> shims;
+
+static CRshim& shimFor(const std::string& target)
+{
+    auto& s = shims[target];
+    if (! s) {
+        s.reset(new CRshim(*shims.at("local"), target));
+    }
+    return *s;
+}
+
+/*
+ * One CLI connection and the request it made.
+ */
+class Session : public std::enable_shared_from_this<Session>
+{
+  public:
+    explicit Session(boost::asio::io_service& io) : m_sock{io} {}
+
+    stream::socket& socket() { return m_sock; }
+
+    void start()
+    {
+        auto self = shared_from_this();
+        boost::asio::async_read_until(m_sock, m_in, '\n', [self](const auto& ec, size_t) {
+            if (! ec) {
+                self->request();
+            }
+        });
+    }
+
+  private:
+    void request()
+    {
+        std::string line;
+        std::getline(std::istream(&m_in), line);
+        std::map<std::string, std::string> f;
+        std::istringstream is(line);
+        for (std::string kv; std::getline(is, kv, '\t'); ) {
+            if (auto eq = kv.find('='); eq != kv.npos) {
+                f[kv.substr(0, eq)] = kv.substr(eq + 1);
+            }
+        }
+        auto num = [&f](const char* k, uint32_t dflt) {
+            uint32_t v = dflt;
+            if (auto i = f.find(k); i != f.end()) {
+                std::from_chars(i->second.data(), i->second.data() + i->second.size(), v);
+            }
+            return v;
+        };
+        m_ptype = f["p"];
+        m_pargs = f["a"];
+        auto target = f.count("t")? f["t"] : "local";
+        m_count = std::clamp(num("c", 1), 1u, 10000u);
+        m_interval = ndn::time::milliseconds(std::max(num("i", 1000), 10u));
+        m_wait = ndn::time::milliseconds(std::max(num("w", 1000), 100u));
+        if (m_ptype.empty() || target.empty()) {
+            write("dnmpAgent: request needs a probe type\n");
+            finish();
+            return;
+        }
+        if (debug) {
+            std::cerr << "request: " << target << " " << m_ptype << " " << m_pargs << "\n";
+        }
+        m_shim = &shimFor(target);
+        send();
+    }
+
+    // send a command and schedule sending the next (as genericCLI does)
+    void send()
+    {
+        auto self = shared_from_this();
+        auto listen = m_interval * (m_count - 1) + m_wait;
+        CmdOpts opts{{"dl", std::to_string(
+                    ndn::time::duration_cast<ndn::time::milliseconds>(listen).count())}};
+        m_topics.push_back(m_shim->sendCmd(m_ptype, m_pargs,
+                    [self](const Reply& r, CRshim&) { self->reply(r); }, opts));
+        if (--m_count > 0) {
+            m_timer = m_shim->schedule(m_interval, [self] { self->send(); });
+        } else {
+            m_timer = m_shim->schedule(m_wait, [self] { self->finish(); });
+        }
+    }
+
+    void reply(const Reply& pub)
+    {
+        auto [out, trailer] = ReplyTrailer::split(pub.getContent());
+        std::ostringstream s;
+        if (out.size() > 0) {
+            s << out << "\n";
+        }
+        s << "Reply from " << pub["rSrcId"] << ": timing (in sec.): "
+          << "to NOD=" << pub.timeDelta("rTS", "cTS")
+          << "  from NOD=" << pub.timeDelta("rTS") << "\n";
+        write(s.str());
+    }
+
+    // stop listening for replies and close once the output is written
+    void finish()
+    {
+        for (const auto& t : m_topics) {
+            m_shim->endCmd(t);
+        }
+        m_topics.clear();
+        m_done = true;
+        if (m_out.empty()) {
+            m_sock.close();
+        }
+    }
+
+    void write(std::string&& s)
+    {
+        m_out.push_back(std::move(s));
+        if (m_out.size() == 1) {
+            writeNext();
+        }
+    }
+
+    void writeNext()
+    {
+        auto self = shared_from_this();
+        boost::asio::async_write(m_sock, boost::asio::buffer(m_out.front()),
+                                 [self](const auto& ec, size_t) {
+            self->m_out.pop_front();
+            if (ec) {
+                // CLI went away: stop sending its commands too
+                self->m_out.clear();
+                self->m_timer.cancel();
+                self->finish();
+                return;
+            }
+            if (! self->m_out.empty()) {
+                self->writeNext();
+            } else if (self->m_done) {
+                self->m_sock.close();
+            }
+        });
+    }
+
+    stream::socket m_sock;
+    boost::asio::streambuf m_in{};
+    std::deque<std::string> m_out{};
+    CRshim* m_shim{};
+    std::string m_ptype{};
+    std::string m_pargs{};
+    uint32_t m_count{};
+    ndn::time::nanoseconds m_interval{};
+    ndn::time::nanoseconds m_wait{};
+    std::vector<RName> m_topics{};
+    Timer m_timer{};
+    bool m_done{false};
+};
+
+static void accept(stream::acceptor& acc)
+{
+    auto s = std::make_shared<Session>(acc.get_io_service());
+    acc.async_accept(s->socket(), [&acc, s](const auto& ec) {
+        if (ec) {
+            return;
+        }
+        // commands run as us so only we may send them
+        if (peerIsUs(s->socket().native_handle())) {
+            s->start();
+        } else {
+            s->socket().close();
+        }
+        accept(acc);
+    });
+}
+
+static struct option opts[] = {
+    {"target", required_argument, nullptr, 't'},
+    {"debug", no_argument, nullptr, 'd'},
+    {"help", no_argument, nullptr, 'h'}
+};
+
+static void usage(const char* cname)
+{
+    std::cerr << "usage: " << cname << " [--debug] [-t|--target name]...\n"
+                 "  (targets to keep warm from the start; 'local' and 'all' always are)\n";
+}
+
+int main(int argc, char* argv[])
+{
+    std::vector<std::string> targets{"all"};
+    for (int c; (c = getopt_long(argc, argv, "t:dh", opts, nullptr)) != -1;) {
+        switch (c) {
+        case 't':
+            targets.emplace_back(optarg);
+            break;
+        case 'd':
+            ++debug;
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        }
+    }
+    try {
+        auto& local = *(shims["local"] = std::make_unique<CRshim>("local"));
+        for (const auto& t : targets) {
+            // (pubsub() sets up the shim's sync session now rather than on
+            // its first command)
+            shimFor(t).pubsub();
+        }
+        if (! local.isLocalLink()) {
+            local.pubsub();
+        }
+        auto path = agentSockPath();
+        if (! agentSockDirOk(path, true)) {
+            throw std::runtime_error("directory of " + path +
+                                     " must be ours and not writable by others");
+        }
+        ::unlink(path.c_str());
+        stream::acceptor acc(local.ioService(), stream::endpoint(path));
+        accept(acc);
+        local.run();
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,476 @@
+/*
+ * dnmp-bench.cpp: benchmarks of DNMP components that run without an NFD
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * dnmpBench runs DNMP code paths against dummy faces so their cost can be
+ * measured on build hosts:
+ *
+ *   dnmpBench probes [-n max_entries] [-s segment_size] [-r reps]
+ *      fetch+parse+format cost of the NFD probes against a FakeNfd whose
+ *      datasets grow by 10x from 10 entries up to max_entries (<= 100000)
+ *
+ *   dnmpBench tput [-s data_size] [-t ms]
+ *      goodput and per-Data cost of the TputPull probe's consumer and a
+ *      TputServer on one dummy face (no forwarder) for windows of 1 to 64
+ *
+ *   dnmpBench ingest [-n pubs]
+ *      heap allocations, bytes allocated and time per publication for
+ *      syncps to take in sync Data carrying 10 new publications each
+ *
+ *   dnmpBench pending [-n max_interests] [-r reps]
+ *      time for a local publish to answer every pending peer sync Interest
+ *      for 1 to max_interests (<= 10000) pending Interests
+ *
+ *   dnmpBench local [-n round_trips] [-s reply_size]
+ *      round trip time of a command and reply over a local link (client
+ *      and server ends in this process, on one event loop)
+ *
+ *   dnmpBench riblt [-n max_difference] [-r reps]
+ *      symbols, bytes and interest rounds for a rateless iblt session (as
+ *      syncps batches them) to decode set differences of 1 to
+ *      max_difference (<= 10000) and whether syncps' fixed iblt could
+ */
+
+#include <getopt.h>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <set>
+#include <thread>
+
+#include "CRshim.hpp"
+#include "probes.hpp"
+#include "fake-nfd.hpp"
+#include "tput.hpp"
+#include "prefix-ping.hpp"
+
+/*
+ * Heap allocation counts (for 'ingest'). Only allocations made while
+ * 'counting' is set are counted.
+ */
+static std::atomic<bool> counting{false};
+static std::atomic<uint64_t> nAllocs{};
+static std::atomic<uint64_t> allocBytes{};
+
+void* operator new(size_t n)
+{
+    if (counting.load(std::memory_order_relaxed)) {
+        nAllocs.fetch_add(1, std::memory_order_relaxed);
+        allocBytes.fetch_add(n, std::memory_order_relaxed);
+    }
+    if (auto p = malloc(n? n : 1); p) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static struct option opts[] = {
+    {"entries", required_argument, nullptr, 'n'},
+    {"segsize", required_argument, nullptr, 's'},
+    {"reps", required_argument, nullptr, 'r'},
+    {"time", required_argument, nullptr, 't'},
+    {"help", no_argument, nullptr, 'h'}
+};
+
+static size_t maxEntries = 100000;
+static size_t segSize = 8000;
+static int reps = 5;
+static std::chrono::milliseconds benchTime{1000};
+
+static void usage(const char* cname)
+{
+    std::cerr << "usage: " << cname << " probes [-n max_entries] [-s segment_size] [-r reps]\n"
+              << "       " << cname << " tput [-s data_size] [-t ms]\n"
+              << "       " << cname << " ingest [-n pubs]\n"
+              << "       " << cname << " pending [-n max_interests] [-r reps]\n"
+              << "       " << cname << " local [-n round_trips] [-s reply_size]\n"
+              << "       " << cname << " riblt [-n max_difference] [-r reps]\n";
+}
+
+/*
+ * time 'reps' calls of 'probe' and print the mean per-call cost
+ */
+static void timeProbe(const char* name, std::string (*probe)(const std::string&),
+                      const std::string& args, size_t entries, size_t segs)
+{
+    using namespace std::chrono;
+    size_t outBytes{};
+    auto start = steady_clock::now();
+    for (int i = 0; i < reps; ++i) {
+        outBytes = probe(args).size();
+    }
+    auto us = duration_cast<duration<double, std::micro>>(steady_clock::now() - start).count() / reps;
+    std::cout << std::left << std::setw(18) << name << std::right
+              << std::setw(8) << entries << std::setw(6) << segs
+              << std::setw(11) << outBytes << std::setw(13) << std::fixed
+              << std::setprecision(1) << us << std::setw(10)
+              << std::setprecision(3) << (entries? us / entries : 0.) << "\n";
+}
+
+static void benchProbes()
+{
+    std::cout << "probe              entries  segs  out_bytes  us_per_call  us_per_entry\n";
+    for (size_t n = 10; n <= maxEntries; n *= 10) {
+        FakeNfd nfd({n, n, n, segSize});
+        nfd.install();
+        timeProbe("NFDGeneralStatus", nfdGSProbe, "", 1,
+                  nfd.segments("/localhost/nfd/status/general"));
+        timeProbe("NFDRIB", nfdRIBProbe, "", n, nfd.segments("/localhost/nfd/rib/list"));
+        timeProbe("NFDRIB(match)", nfdRIBProbe, "/fake/prefix", n,
+                  nfd.segments("/localhost/nfd/rib/list"));
+        timeProbe("NFDFaceStatus", nfdFSProbe, "", n, nfd.segments("/localhost/nfd/faces/list"));
+        timeProbe("NFDStrategy", nfdStrategyProbe, "", n,
+                  nfd.segments("/localhost/nfd/strategy-choice/list"));
+        timeProbe("NFDCsInfo", nfdCsInfoProbe, "", 1, nfd.segments("/localhost/nfd/cs/info"));
+        FakeNfd::uninstall();
+    }
+}
+
+/*
+ * The server answers the client's Interests from the face's event loop so
+ * the numbers are the pair's own cost and the most Data/sec the probe could
+ * handle on one core.
+ */
+static void benchTput()
+{
+    std::cout << "window  size    data/s  goodput(Mbps)  cpu_us_per_data  rtt_p50(ms)  rtt_p99(ms)\n";
+    ndn::KeyChain keyChain("pib-memory:", "tpm-memory:");
+    auto size = std::min(segSize, TputServer::maxSize);
+    for (uint32_t w : {1, 4, 16, 64}) {
+        using ndn::util::DummyClientFace;
+        DummyClientFace face(keyChain, DummyClientFace::Options{false, false});
+        TputServer server(face, "/bench/tput");
+        face.onSendInterest.connect([&face, &server](const ndn::Interest& i) {
+            face.getIoService().post([&face, &server, i] { face.receive(server.make(i)); });
+        });
+        TputClient::Result res;
+        TputClient::Params p;
+        p.size = size;
+        p.duration = benchTime;
+        p.window = w;
+        TputClient client(face, "/bench/tput", p,
+                          [&res](TputClient::Result&& r) { res = std::move(r); });
+        auto cpu = std::clock();
+        client.start();
+        face.processEvents();
+        auto cpuUs = double(std::clock() - cpu) * 1e6 / CLOCKS_PER_SEC;
+        std::cout << std::setw(6) << w << std::setw(6) << size << std::fixed
+                  << std::setprecision(0) << std::setw(10) << (res.secs > 0? res.data / res.secs : 0.)
+                  << std::setprecision(1) << std::setw(15) << res.mbps()
+                  << std::setprecision(2) << std::setw(17) << (res.data? cpuUs / res.data : 0.)
+                  << std::setprecision(3) << std::setw(13) << res.rtt(.5)
+                  << std::setw(13) << res.rtt(.99) << "\n";
+    }
+}
+
+/*
+ * Feed a SyncPubsub on a dummy face sync Data answering its own sync
+ * Interests, each carrying 10 new 100-byte publications. The Data are built
+ * outside the counted section so the counts are syncps' own (validation,
+ * decode, active set insert, delivery and sending the next sync Interest).
+ */
+static void benchIngest()
+{
+    using ndn::util::DummyClientFace;
+    constexpr size_t perData = 10;
+    ndn::KeyChain keyChain("pib-memory:", "tpm-memory:");
+    DummyClientFace face(keyChain, DummyClientFace::Options{true, true});
+    SyncPubsub sync(face, "/bench/sync", [](const auto&) { return false; },
+                    [](auto& ours, auto&) { return ours; });
+    uint64_t delivered{};
+    sync.subscribeTo("/bench/pub", [&delivered](const auto&) { ++delivered; });
+    face.processEvents(ndn::time::milliseconds(10));  // register & first sync Interest
+    face.getIoService().reset();
+
+    std::vector<uint8_t> payload(100, 'p');
+    size_t pubs{};
+    std::chrono::steady_clock::duration busy{};
+    while (pubs < maxEntries) {
+        if (face.sentInterests.empty()) {
+            throw std::runtime_error("ingest: no sync interest to answer");
+        }
+        ndn::Block content(syncps::tlv::syncpsContent);
+        for (size_t i = 0; i < perData; ++i) {
+            ndn::Data p(ndn::Name("/bench/pub").appendNumber(pubs + i));
+            p.setContent(payload.data(), payload.size());
+            keyChain.sign(p, ndn::security::signingWithSha256());
+            content.push_back(p.wireEncode());
+        }
+        content.encode();
+        ndn::Data d(face.sentInterests.back().getName());
+        d.setContent(content);
+        keyChain.sign(d, ndn::security::signingWithSha256());
+        face.sentInterests.clear();
+
+        auto start = std::chrono::steady_clock::now();
+        counting = true;
+        face.receive(d);
+        face.getIoService().poll();
+        counting = false;
+        busy += std::chrono::steady_clock::now() - start;
+        pubs += perData;
+    }
+    std::cout << "    pubs  delivered  allocs_per_pub  bytes_alloc_per_pub  us_per_pub\n"
+              << std::fixed << std::setprecision(1) << std::setw(8) << pubs
+              << std::setw(11) << delivered
+              << std::setw(16) << double(nAllocs) / pubs
+              << std::setw(21) << double(allocBytes) / pubs
+              << std::setprecision(2) << std::setw(12)
+              << std::chrono::duration<double, std::micro>(busy).count() / pubs << "\n";
+}
+
+/*
+ * Give a SyncPubsub 'n' peer sync Interests it can't answer (each peer's
+ * iblt holds one pub we don't have) then time one local publish, which
+ * answers them all. Repeated 'reps' times for each 'n'.
+ */
+static void benchPending()
+{
+    using ndn::util::DummyClientFace;
+    std::cout << "pending  us_per_publish  us_per_interest\n";
+    ndn::KeyChain keyChain("pib-memory:", "tpm-memory:");
+    DummyClientFace face(keyChain, DummyClientFace::Options{false, true});
+    SyncPubsub sync(face, "/bench/sync", [](const auto&) { return false; },
+                    [](auto& ours, auto&) { return ours; });
+    face.processEvents(ndn::time::milliseconds(10));  // register & first sync Interest
+    face.getIoService().reset();
+
+    uint32_t key{}, seq{};
+    for (size_t n = 1; n <= std::min<size_t>(maxEntries, 10000); n *= 10) {
+        std::chrono::steady_clock::duration busy{};
+        for (int r = 0; r < reps; ++r) {
+            for (size_t i = 0; i < n; ++i) {
+                syncps::IBLT iblt(85);
+                iblt.insert(++key);
+                ndn::Name name("/bench/sync");
+                iblt.appendToName(name);
+                ndn::Interest interest(name);
+                interest.setCanBePrefix(true);
+                interest.setMustBeFresh(true);
+                face.receive(interest);
+            }
+            face.getIoService().poll();
+            face.sentData.clear();
+            face.sentInterests.clear();
+
+            auto start = std::chrono::steady_clock::now();
+            sync.publish(ndn::Data(ndn::Name("/bench/pub").appendNumber(seq++).appendTimestamp()));
+            busy += std::chrono::steady_clock::now() - start;
+            if (face.sentData.size() != n) {
+                throw std::runtime_error("pending: " + std::to_string(face.sentData.size()) +
+                                         " of " + std::to_string(n) + " interests answered");
+            }
+        }
+        auto us = std::chrono::duration<double, std::micro>(busy).count() / reps;
+        std::cout << std::setw(7) << n << std::fixed << std::setprecision(1)
+                  << std::setw(16) << us << std::setprecision(3)
+                  << std::setw(17) << us / n << "\n";
+    }
+}
+
+/*
+ * Send a command over a local link and answer it with a 'segSize' reply,
+ * one at a time, 'maxEntries' times. The server end runs on its own thread
+ * and event loop, as it would in the NOD.
+ */
+static void benchLocal()
+{
+    using clock = std::chrono::steady_clock;
+    // (the server wants a socket directory only we can write)
+    char dir[] = "/tmp/dnmp-bench-XXXXXX";
+    if (! mkdtemp(dir)) {
+        throw std::runtime_error("local: can't make socket directory");
+    }
+    auto path = std::string(dir) + "/local.sock";
+    std::string reply(std::min<size_t>(segSize, 100000), 'r');
+    boost::asio::io_service nodIo, clientIo;
+    LocalServer* srv{};
+    LocalServer server(nodIo, path, [](pid_t) { return std::string("bench"); },
+                       [&srv, &reply](auto id, uid_t, const auto& n, auto) { srv->send(id, n, reply); });
+    srv = &server;
+    std::thread nod([&nodIo] { nodIo.run(); });
+
+    ndn::Name cmd("/myHouse/dnmp/nod/local/command/uid0/Pinger");
+    size_t trips{};
+    clock::time_point sent;
+    LogHist rtt;
+    double sumUs{};
+    std::unique_ptr<LocalLink> link;
+    auto send = [&] {
+        sent = clock::now();
+        link->send(cmd, {});
+    };
+    link = LocalLink::connect(clientIo, path, [&](const auto&, auto) {
+        auto us = std::chrono::duration<double, std::micro>(clock::now() - sent).count();
+        rtt.add(us);
+        sumUs += us;
+        if (++trips < maxEntries) {
+            send();
+        } else {
+            clientIo.stop();
+        }
+    });
+    unlink(path.c_str());
+    rmdir(dir);
+    if (! link) {
+        nodIo.stop();
+        nod.join();
+        throw std::runtime_error("local: can't connect");
+    }
+    send();
+    clientIo.run();
+    nodIo.stop();
+    nod.join();
+    std::cout << "   trips  reply_bytes  avg_us  p50_us  p99_us\n" << std::fixed
+              << std::setprecision(1) << std::setw(8) << trips << std::setw(13) << reply.size()
+              << std::setw(8) << sumUs / trips << std::setw(8) << rtt.pct(.5)
+              << std::setw(8) << rtt.pct(.99) << "\n";
+}
+
+/*
+ * Reconcile two sets that share 1000 keys and differ by 'd' (split at random
+ * between them) the way syncps' rateless sessions do: the first interest
+ * carries 16 symbols and each continuation twice as many as the last, up
+ * to 600. Repeated 'reps' times for each 'd'. For comparison, also decodes
+ * the difference of the sets' default-size (85 entry) IBLTs when 'd' isn't
+ * far past what they hold.
+ */
+static void benchRiblt()
+{
+    using namespace syncps;
+    std::cout << "   diff  symbols  sym_per_diff  bytes  rounds  decode_us  iblt_ok\n";
+    std::mt19937 rng(1);
+    for (size_t d = 1; d <= std::min<size_t>(maxEntries, 10000); d *= 10) {
+        size_t symbols{}, rounds{}, ibltOk{};
+        std::chrono::steady_clock::duration busy{};
+        for (int r = 0; r < reps; ++r) {
+            std::set<uint32_t> common, ours, theirs;
+            while (common.size() < 1000) {
+                common.insert(rng());
+            }
+            while (ours.size() + theirs.size() < d) {
+                if (auto k = rng(); common.count(k) == 0) {
+                    (rng() & 1? ours : theirs).insert(k);
+                }
+            }
+            riblt::Encoder eo, et;
+            IBLT io(85), it(85);
+            for (auto k : common) {
+                eo.add(k);
+                et.add(k);
+                io.insert(k);
+                it.insert(k);
+            }
+            for (auto k : ours) {
+                eo.add(k);
+                io.insert(k);
+            }
+            for (auto k : theirs) {
+                et.add(k);
+                it.insert(k);
+            }
+            auto start = std::chrono::steady_clock::now();
+            riblt::Decoder dec(std::move(eo));
+            for (size_t batch = ribltFirstBatch; ; batch = std::min(batch * 2, ribltMaxBatch)) {
+                ++rounds;
+                dec.add(et.next(batch));
+                if (dec.decode() || dec.size() >= ribltMaxSymbols) {
+                    break;
+                }
+            }
+            busy += std::chrono::steady_clock::now() - start;
+            if (! dec.decoded() || dec.ours().size() != ours.size() ||
+                dec.theirs().size() != theirs.size()) {
+                throw std::runtime_error("riblt: difference of " + std::to_string(d) +
+                                         " not decoded");
+            }
+            symbols += dec.size();
+            std::set<uint32_t> pos, neg;
+            if (d <= 100 && (io - it).listEntries(pos, neg) && pos == ours && neg == theirs) {
+                ++ibltOk;
+            }
+        }
+        std::cout << std::setw(7) << d << std::setw(9) << symbols / reps << std::fixed
+                  << std::setprecision(2) << std::setw(14) << double(symbols) / reps / d
+                  << std::setw(7) << symbols * 12 / reps << std::setprecision(1)
+                  << std::setw(8) << double(rounds) / reps << std::setw(11)
+                  << std::chrono::duration<double, std::micro>(busy).count() / reps
+                  << std::setw(6) << (d <= 100? std::to_string(ibltOk) + "/" + std::to_string(reps)
+                                               : std::string("-")) << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc <= 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    std::string what(argv[1]);
+    optind = 2;
+    for (int c; (c = getopt_long(argc, argv, "n:s:r:t:h", opts, nullptr)) != -1;) {
+        switch (c) {
+        case 'n':
+            maxEntries = std::min<size_t>(std::stoul(optarg), FakeNfd::maxEntries);
+            break;
+        case 's':
+            segSize = std::max<size_t>(std::stoul(optarg), 100);
+            break;
+        case 'r':
+            reps = std::max(std::stoi(optarg), 1);
+            break;
+        case 't':
+            benchTime = std::chrono::milliseconds(std::max(std::stoi(optarg), 10));
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        }
+    }
+    try {
+        if (what == "probes") {
+            benchProbes();
+        } else if (what == "tput") {
+            benchTput();
+        } else if (what == "ingest") {
+            benchIngest();
+        } else if (what == "pending") {
+            benchPending();
+        } else if (what == "local") {
+            benchLocal();
+        } else if (what == "riblt") {
+            benchRiblt();
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,131 @@
+/*
+ * dnmp-cli.cpp: thin command line client of dnmpAgent
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * dnmpCLI takes genericCLI's probe flags, hands the request to a running
+ * dnmpAgent (see dnmp-agent.cpp) and copies the replies the agent streams
+ * back to stdout. It has no NDN state of its own so it starts instantly.
+ */
+
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "agent-sock.hpp"
+
+static struct option opts[] = {
+    {"probe", required_argument, nullptr, 'p'},
+    {"arguments", required_argument, nullptr, 'a'},
+    {"target", required_argument, nullptr, 't'},
+    {"count", required_argument, nullptr, 'c'},
+    {"interval", required_argument, nullptr, 'i'},
+    {"wait", required_argument, nullptr, 'w'},
+    {"help", no_argument, nullptr, 'h'}
+};
+
+static void usage(const char* cname)
+{
+    std::cerr << "usage: " << cname << " [-t target] [-a args] [-c count] [-i interval]"
+                 " [-w wait] -p probe_name\n"
+                 "  (as genericCLI; interval and wait in sec.)\n";
+}
+
+// seconds (as text) to ms (as text)
+static std::string ms(const char* secs)
+{
+    return std::to_string(long(std::strtod(secs, nullptr) * 1000));
+}
+
+int main(int argc, char* argv[])
+{
+    std::string req;
+    bool probe{false};
+    for (int c; (c = getopt_long(argc, argv, "p:a:t:c:i:w:h", opts, nullptr)) != -1;) {
+        switch (c) {
+        case 'p':
+            req += std::string("p=") + optarg + "\t";
+            probe = true;
+            break;
+        case 'a':
+            req += std::string("a=") + optarg + "\t";
+            break;
+        case 't':
+            req += std::string("t=") + optarg + "\t";
+            break;
+        case 'c':
+            req += std::string("c=") + optarg + "\t";
+            break;
+        case 'i':
+            req += "i=" + ms(optarg) + "\t";
+            break;
+        case 'w':
+            req += "w=" + ms(optarg) + "\t";
+            break;
+        case 'h':
+            usage(argv[0]);
+            exit(0);
+        }
+    }
+    if (optind < argc || ! probe) {
+        usage(argv[0]);
+        return 1;
+    }
+    req.back() = '\n';
+
+    auto path = agentSockPath();
+    if (! agentSockDirOk(path)) {
+        std::cerr << "directory of " << path << " isn't ours or others can write it" << std::endl;
+        return 1;
+    }
+    int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+    if (s < 0 || connect(s, (sockaddr*)&sa, sizeof(sa)) < 0) {
+        std::cerr << "no dnmpAgent at " << path << ": " << strerror(errno) << std::endl;
+        return 1;
+    }
+    if (! peerIsUs(s)) {
+        std::cerr << "dnmpAgent at " << path << " isn't running as us" << std::endl;
+        return 1;
+    }
+    if (write(s, req.data(), req.size()) != ssize_t(req.size())) {
+        std::cerr << "dnmpAgent write: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    char buf[16384];
+    for (ssize_t n; (n = read(s, buf, sizeof(buf))) != 0; ) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "dnmpAgent read: " << strerror(errno) << std::endl;
+            return 1;
+        }
+        std::cout.write(buf, n).flush();
+    }
+}
@@ -0,0 +1,153 @@
+#ifndef ECHO_MESH_HPP
+#define ECHO_MESH_HPP
+/*
+ * echo-mesh.hpp: all-pairs NOD-to-NOD echo latency measurement
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * Every NOD that gets the same mesh command runs an EchoMesh in the sync
+ * group the command arrived on. Each NOD publishes 'count' echo requests,
+ * 'interval' apart, starting at an offset (derived from its ID) within the
+ * first interval so the NODs' requests interleave rather than collide.
+ * Each NOD answers every other NOD's requests and times the answers to its
+ * own, so a single command measures all pairs concurrently. When done, a
+ * NOD's result is its row of the latency matrix: per-peer answer count and
+ * min/avg/max round trip time.
+ *
+ * Echo names (in the command's sync group) are:
+ *   <root>/<domain>/echo/<run>/q/<requester>/<seq>/<ts>
+ *   <root>/<domain>/echo/<run>/r/<requester>/<seq>/<responder>/<ts>
+ * where <run> identifies the command.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CRshim.hpp"
+
+class EchoMesh
+{
+  public:
+    using clock = std::chrono::steady_clock;
+    using Done = std::function<void(std::string&&)>;
+
+    struct Params {
+        uint32_t count{10};
+        std::chrono::milliseconds interval{100};
+        std::chrono::milliseconds wait{1000};   // for answers after the last request
+    };
+
+    EchoMesh(CRshim& shim, const std::string& run, const Params& p, Done&& done)
+        : m_shim{shim}, m_self{CRshim::myPID()}, m_p{p}, m_done{std::move(done)},
+          m_base{shim.prefix().getPrefix(2).append("echo").append(run)},
+          m_sent(p.count)
+    {}
+
+    void start()
+    {
+        m_shim.subscribe(Name(m_base).append("q"), [this](const auto& p) { answer(p); })
+              .subscribe(Name(m_base).append("r").append(m_self),
+                         [this](const auto& p) { answered(p); });
+        auto stagger = std::hash<std::string>{}(m_self) % m_p.interval.count();
+        m_timer = m_shim.schedule(ndn::time::milliseconds(stagger), [this] { request(); });
+    }
+
+  private:
+    void request()
+    {
+        m_sent[m_seq] = clock::now();
+        m_shim.publish(Name(m_base).append("q").append(m_self).appendNumber(m_seq));
+        if (++m_seq < m_p.count) {
+            m_timer = m_shim.schedule(ndn::time::milliseconds(m_p.interval.count()),
+                                      [this] { request(); });
+        } else {
+            m_timer = m_shim.schedule(ndn::time::milliseconds(m_p.wait.count()),
+                                      [this] { finish(); });
+        }
+    }
+
+    // q/<requester>/<seq>/<ts>: echo it back as r/<requester>/<seq>/<us>
+    void answer(const Publication& p)
+    {
+        const auto& n = p.getName();
+        auto i = m_base.size() + 1;
+        m_shim.publish(Name(m_base).append("r").append(n[i]).append(n[i + 1]).append(m_self));
+    }
+
+    // r/<us>/<seq>/<responder>/<ts>
+    void answered(const Publication& p)
+    {
+        auto now = clock::now();
+        const auto& n = p.getName();
+        auto i = m_base.size() + 2;
+        auto seq = n[i].toNumber();
+        if (seq >= m_seq) {
+            return;
+        }
+        auto& s = m_peer[n[i + 1].toUri()];
+        double ms = std::chrono::duration<double, std::milli>(now - m_sent[seq]).count();
+        s.min = s.n? std::min(s.min, ms) : ms;
+        s.max = std::max(s.max, ms);
+        s.sum += ms;
+        ++s.n;
+    }
+
+    void finish()
+    {
+        m_shim.unsubscribe(Name(m_base).append("q"))
+              .unsubscribe(Name(m_base).append("r").append(m_self));
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(3);
+        for (const auto& [peer, st] : m_peer) {
+            s << peer << " sent " << m_p.count << " rcvd " << st.n << " rtt(ms) min "
+              << st.min << " avg " << st.sum / st.n << " max " << st.max << "\n";
+        }
+        // the callback may destroy this object so it must be called last
+        auto done = std::move(m_done);
+        done(s.str());
+    }
+
+    struct PeerStats {
+        uint32_t n{};
+        double min{};
+        double max{};
+        double sum{};
+    };
+
+    CRshim& m_shim;
+    std::string m_self;
+    Params m_p;
+    Done m_done;
+    Name m_base;
+    std::vector<clock::time_point> m_sent;
+    uint32_t m_seq{};
+    std::map<std::string, PeerStats> m_peer{};
+    Timer m_timer{};
+};
+
+#endif // ECHO_MESH_HPP
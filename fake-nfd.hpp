@@ -0,0 +1,268 @@
+#ifndef FAKE_NFD_HPP
+#define FAKE_NFD_HPP
+/*
+ * fake-nfd.hpp: stand-in NFD management responder for DNMP probes
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * FakeNfd answers the /localhost/nfd/... management Interests used by the
+ * probes in probes.hpp on a DummyClientFace, so probes can be exercised and
+ * benchmarked on hosts with no forwarder. The datasets are synthetic, built
+ * once at construction with the configured number of entries and split into
+ * segments of the configured size the way NFD segments them
+ * (<dataset>/<version>/<segment> with a FinalBlockId).
+ *
+ * It uses nfdManagementQ so must be included after probes.hpp. Usage:
+ *     FakeNfd nfd({10000, 100, 20});
+ *     nfd.install();              // probes now get their faces from nfd
+ *     auto s = nfdRIBProbe("");
+ */
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <ndn-cxx/encoding/block-helpers.hpp>
+#include <ndn-cxx/mgmt/nfd/cs-info.hpp>
+#include <ndn-cxx/mgmt/nfd/face-status.hpp>
+#include <ndn-cxx/mgmt/nfd/forwarder-status.hpp>
+#include <ndn-cxx/mgmt/nfd/rib-entry.hpp>
+#include <ndn-cxx/mgmt/nfd/strategy-choice.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/signing-helpers.hpp>
+#include <ndn-cxx/util/dummy-client-face.hpp>
+
+class FakeNfd
+{
+  public:
+    struct Config {
+        size_t ribEntries{100};     // entries in rib/list
+        size_t faces{10};           // entries in faces/list
+        size_t strategies{5};       // entries in strategy-choice/list
+        size_t segSize{8000};       // max content bytes per segment
+    };
+    static constexpr size_t maxEntries = 100000;
+
+    explicit FakeNfd(const Config& cfg) : m_cfg{cfg}
+    {
+        if (m_cfg.ribEntries > maxEntries || m_cfg.faces > maxEntries ||
+            m_cfg.strategies > maxEntries) {
+            throw std::invalid_argument("FakeNfd: too many dataset entries");
+        }
+        if (m_cfg.segSize == 0) {
+            m_cfg.segSize = 8000;
+        }
+        makeStatus();
+        makeRib();
+        makeFaces();
+        makeStrategies();
+        makeCsInfo();
+    }
+
+    /*
+     * Make a new dummy face that answers management Interests from
+     * this responder's datasets. Unknown datasets get a Nack.
+     */
+    std::unique_ptr<ndn::Face> face()
+    {
+        using ndn::util::DummyClientFace;
+        auto f = std::make_unique<DummyClientFace>(m_keyChain,
+                                                   DummyClientFace::Options{false, false});
+        auto fp = f.get();
+        f->onSendInterest.connect([this, fp](const ndn::Interest& i) {
+            // answer from the event loop, like a real forwarder would
+            if (auto d = lookup(i.getName()); d) {
+                fp->getIoService().post([fp, d] { fp->receive(*d); });
+            } else {
+                ndn::lp::Nack nack(i);
+                nack.setReason(ndn::lp::NackReason::NO_ROUTE);
+                fp->getIoService().post([fp, nack] { fp->receive(nack); });
+            }
+        });
+        return f;
+    }
+
+    // route all nfdManagementQ fetches to this responder
+    FakeNfd& install()
+    {
+        ndn::nfdManagementQ::makeFace = [this] { return face(); };
+        return *this;
+    }
+    static void uninstall()
+    {
+        ndn::nfdManagementQ::makeFace = [] { return std::make_unique<ndn::Face>(); };
+    }
+
+    const Config& config() const { return m_cfg; }
+
+    // number of segments and total content bytes of dataset 'ds'
+    size_t segments(const std::string& ds) const { return m_sets.at(ndn::Name(ds)).size(); }
+    size_t bytes(const std::string& ds) const
+    {
+        size_t n{};
+        for (const auto& d : m_sets.at(ndn::Name(ds))) n += d->getContent().value_size();
+        return n;
+    }
+
+  private:
+    using DataPtr = std::shared_ptr<const ndn::Data>;
+
+    DataPtr lookup(const ndn::Name& n) const
+    {
+        for (const auto& [pfx, segs] : m_sets) {
+            if (! pfx.isPrefixOf(n)) {
+                continue;
+            }
+            if (n.size() == pfx.size()) {
+                return segs.front();
+            }
+            // <dataset>/<version>/<segment>
+            if (n.size() == pfx.size() + 2 && n[-1].isSegment() &&
+                n[-1].toSegment() < segs.size()) {
+                return segs[n[-1].toSegment()];
+            }
+        }
+        return nullptr;
+    }
+
+    /*
+     * split the encoded dataset 'buf' into segSize pieces and
+     * publish them as the segments of dataset 'ds'
+     */
+    void addDataset(const std::string& ds, const std::vector<uint8_t>& buf)
+    {
+        auto& segs = m_sets[ndn::Name(ds)];
+        auto nseg = std::max<size_t>(1, (buf.size() + m_cfg.segSize - 1) / m_cfg.segSize);
+        ndn::Name base(ds);
+        base.appendVersion();
+        const auto last = ndn::name::Component::fromSegment(nseg - 1);
+        for (size_t s = 0; s < nseg; ++s) {
+            auto off = s * m_cfg.segSize;
+            auto len = std::min(m_cfg.segSize, buf.size() - std::min(off, buf.size()));
+            auto d = std::make_shared<ndn::Data>(ndn::Name(base).appendSegment(s));
+            d->setContent(ndn::makeBinaryBlock(ndn::tlv::Content, buf.data() + off, len));
+            d->setFreshnessPeriod(ndn::time::seconds(1));
+            d->setFinalBlock(last);
+            m_keyChain.sign(*d, ndn::security::signingWithSha256());
+            segs.push_back(std::move(d));
+        }
+    }
+
+    template<typename T>
+    static void append(std::vector<uint8_t>& buf, const T& item)
+    {
+        const auto& b = item.wireEncode();
+        buf.insert(buf.end(), b.begin(), b.end());
+    }
+
+    void makeStatus()
+    {
+        using namespace ndn::time;
+        auto n = m_cfg.ribEntries;
+        ndn::nfd::ForwarderStatus st;
+        st.setNfdVersion("0.7.0-fake")
+          .setStartTimestamp(system_clock::now() - hours(1))
+          .setCurrentTimestamp(system_clock::now())
+          .setNNameTreeEntries(3 * n)
+          .setNFibEntries(n)
+          .setNPitEntries(n / 10)
+          .setNMeasurementsEntries(n / 20)
+          .setNCsEntries(16384)
+          .setNInInterests(100 * n).setNOutInterests(90 * n)
+          .setNInData(80 * n).setNOutData(85 * n)
+          .setNInNacks(n).setNOutNacks(n / 2)
+          .setNSatisfiedInterests(75 * n).setNUnsatisfiedInterests(5 * n);
+        const auto& b = st.wireEncode();    // already a Content block
+        addDataset("/localhost/nfd/status/general",
+                   std::vector<uint8_t>(b.value_begin(), b.value_end()));
+    }
+
+    void makeRib()
+    {
+        std::vector<uint8_t> buf;
+        for (size_t i = 0; i < m_cfg.ribEntries; ++i) {
+            ndn::nfd::Route rt;
+            rt.setFaceId(256 + i % std::max<size_t>(1, m_cfg.faces))
+              .setOrigin(ndn::nfd::ROUTE_ORIGIN_APP)
+              .setCost(i % 10)
+              .setFlags(ndn::nfd::ROUTE_FLAG_CHILD_INHERIT);
+            ndn::nfd::RibEntry re;
+            re.setName(ndn::Name("/fake/prefix").appendNumber(i)).addRoute(rt);
+            append(buf, re);
+        }
+        addDataset("/localhost/nfd/rib/list", buf);
+    }
+
+    void makeFaces()
+    {
+        std::vector<uint8_t> buf;
+        for (size_t i = 0; i < m_cfg.faces; ++i) {
+            ndn::nfd::FaceStatus fs;
+            fs.setFaceId(256 + i)
+              .setRemoteUri("udp4://10." + std::to_string(i >> 16 & 255) + "." +
+                            std::to_string(i >> 8 & 255) + "." +
+                            std::to_string(i & 255) + ":6363")
+              .setLocalUri("udp4://10.255.255.254:6363")
+              .setFaceScope(ndn::nfd::FACE_SCOPE_NON_LOCAL)
+              .setFacePersistency(ndn::nfd::FACE_PERSISTENCY_PERSISTENT)
+              .setLinkType(ndn::nfd::LINK_TYPE_POINT_TO_POINT)
+              .setNInInterests(1000 + i).setNInData(900 + i).setNInNacks(i)
+              .setNOutInterests(950 + i).setNOutData(850 + i).setNOutNacks(i / 2)
+              .setNInBytes(1000000 + i).setNOutBytes(900000 + i);
+            append(buf, fs);
+        }
+        addDataset("/localhost/nfd/faces/list", buf);
+    }
+
+    void makeStrategies()
+    {
+        std::vector<uint8_t> buf;
+        for (size_t i = 0; i < m_cfg.strategies; ++i) {
+            ndn::nfd::StrategyChoice sc;
+            sc.setName(i == 0? ndn::Name("/") : ndn::Name("/fake/ns").appendNumber(i))
+              .setStrategy(ndn::Name("/localhost/nfd/strategy/best-route").appendVersion(5));
+            append(buf, sc);
+        }
+        addDataset("/localhost/nfd/strategy-choice/list", buf);
+    }
+
+    void makeCsInfo()
+    {
+        auto n = m_cfg.ribEntries;
+        ndn::nfd::CsInfo cs;
+        cs.setCapacity(65536)
+          .setEnableAdmit(true)
+          .setEnableServe(true)
+          .setNEntries(16384)
+          .setNHits(60 * n)
+          .setNMisses(20 * n);
+        std::vector<uint8_t> buf;
+        append(buf, cs);
+        addDataset("/localhost/nfd/cs/info", buf);
+    }
+
+    Config m_cfg;
+    ndn::KeyChain m_keyChain{"pib-memory:", "tpm-memory:"};
+    std::map<ndn::Name, std::vector<DataPtr>> m_sets{};
+};
+
+#endif // FAKE_NFD_HPP
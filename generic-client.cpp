@@ -26,10 +26,20 @@
  */
 
 #include <getopt.h>
+#include <algorithm>
+#include <array>
 #include <charconv>
+#include <fstream>
 #include <functional>
+#include <iomanip>
 #include <iostream>
 #include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <vector>
 
 /*
  * The CRshim object in CRshim.hpp provides the Command/Reply API from
@@ -42,6 +52,8 @@
  *   generic-client -p probe_name -a probe_arguments -t target
  *                  -c count -i interval 
  *-w maximum_wait_time_for_reply
+ * or, to run many commands from one process:
+ *   generic-client -f command_file [-m max_in_flight] [-w wait]
  */
 
 // handles command line
@@ -52,12 +64,17 @@ static struct option opts[] = {
     {"wait", required_argument, nullptr, 'i'},
     {"interval", required_argument, nullptr, 'i'},
     {"count", required_argument, nullptr, 'c'},
+    {"trace", no_argument, nullptr, 'T'},
+    {"at", required_argument, nullptr, 'A'},
+    {"file", required_argument, nullptr, 'f'},
+    {"max-inflight", required_argument, nullptr, 'm'},
     {"debug", no_argument, nullptr, 'd'},
     {"help", no_argument, nullptr, 'h'}
 };
 static void usage(const char* cname)
 {
-    std::cerr << "usage: " << cname << " [flags] -p probe_name\n";
+    std::cerr << "usage: " << cname << " [flags] -p probe_name\n"
+                 "       " << cname << " [flags] -f command_file\n";
 }
 static void help(const char* cname)
 {
@@ -71,6 +88,13 @@ static void help(const char* cname)
            "  -c |--count          number of requests to send\n"
            "  -i |--interval       time between requests (sec)\n"
            "  -w |--wait           time to wait for replies\n"
+           "  -T |--trace          ask NODs where they spent their time\n"
+           "  -A |--at secs        have NODs run each command at the same instant,\n"
+           "                       'secs' after it's sent\n"
+           "  -f |--file path      run the commands in 'path' ('-' for stdin), one\n"
+           "                       per line: target probe [args [count [interval]]]\n"
+           "                       ('-' for no args)\n"
+           "  -m |--max-inflight n with -f, most commands awaiting replies at once\n"
            "  -d |--debug          enable debugging output\n"
            "  -h |--help           print help then exit\n";
 }
@@ -84,22 +108,174 @@ static std::string target("local");
 static std::string ptype;
 static std::string pargs;
 static Timer timer;
+static bool trace{false};
+static ndn::time::nanoseconds atDelay{};
+static std::string batchFile;
+static int maxInFlight = 32;
 
+/*
+ * Per-reply latency breakdown (in sec.) from the reply's timestamps and, if
+ * it was traced, the NOD's TraceSpans. 'sums' accumulates them for the
+ * summary printed on exit.
+ */
+static constexpr std::array<const char*, 6> spanName{
+    "cmd sync", "NOD queue", "NFD fetch", "probe+format", "NOD publish", "reply sync"};
+static std::array<double, spanName.size()> sums{};
+static int nTraced{};
+
+static void printTrace(const Reply& pub, const TraceSpans& ts)
+{
+    auto s = [](uint32_t us) { return us * 1e-6; };
+    // the NOD's receive time is its reply timestamp less the publish offset
+    std::array<double, spanName.size()> span{
+        pub.timeDelta("rTS", "cTS") - s(ts.publish),
+        s(ts.dispatch),
+        s(ts.fetch),
+        s(ts.end - ts.start) - s(ts.fetch),
+        s(ts.publish - ts.end),
+        pub.timeDelta("rTS")};
+    std::cout << "  trace (in sec.):";
+    for (size_t i = 0; i < span.size(); ++i) {
+        std::cout << " " << spanName[i] << "=" << span[i];
+        sums[i] += span[i];
+    }
+    std::cout << std::endl;
+    ++nTraced;
+}
 
 /*
- * processReply handles each reply to a NOD probe command.
- * It's a callback set in the call to issueCmd.
+ * NodMesh replies are rows of the NODs' latency matrix. They're collected
+ * (row NOD -> column NOD -> avg RTT in ms) and printed as a matrix on exit.
  */
-void processReply(const Reply& pub, CRshim& shim)
+static std::map<std::string, std::map<std::string, double>> meshRows;
+
+static void addMeshRow(const std::string& nod, std::string_view row)
 {
-    if (const auto& c = pub.getContent(); c.value_size() > 0) {
-        std::cout << std::string((const char*)(c.value()), c.value_size()) << "\n";
+    auto& r = meshRows[nod];
+    std::istringstream is{std::string(row)};
+    for (std::string line; std::getline(is, line); ) {
+        // <peer> sent <n> rcvd <n> rtt(ms) min <ms> avg <ms> max <ms>
+        std::istringstream ls(line);
+        std::string peer, w;
+        double avg{};
+        ls >> peer;
+        while (ls >> w && w != "avg") {}
+        if (ls >> avg) {
+            r[peer] = avg;
+        }
+    }
+}
+
+static void printMesh()
+{
+    std::set<std::string> nods;
+    for (const auto& [row, cols] : meshRows) {
+        nods.insert(row);
+        for (const auto& c : cols) nods.insert(c.first);
+    }
+    std::cout << "latency matrix (avg RTT in ms from row NOD to column NOD):\n";
+    int i = 0;
+    for (const auto& n : nods) std::cout << "  [" << i++ << "] " << n << "\n";
+    std::cout << "     ";
+    for (size_t c = 0; c < nods.size(); ++c) std::cout << std::setw(9) << "[" + std::to_string(c) + "]";
+    std::cout << "\n" << std::fixed << std::setprecision(2);
+    i = 0;
+    for (const auto& r : nods) {
+        std::cout << std::setw(5) << "[" + std::to_string(i++) + "]";
+        for (const auto& c : nods) {
+            auto row = meshRows.find(r);
+            if (r == c) {
+                std::cout << std::setw(9) << "-";
+            } else if (row == meshRows.end() || row->second.count(c) == 0) {
+                std::cout << std::setw(9) << "?";
+            } else {
+                std::cout << std::setw(9) << row->second.at(c);
+            }
+        }
+        std::cout << "\n";
+    }
+}
+
+/*
+ * For commands with an 'at' instant, when each NOD actually ran the probe
+ * (as offsets in us from the instant), by instant. The spread of each
+ * instant's offsets is how well aligned that snapshot is.
+ */
+static std::map<int64_t, std::vector<int64_t>> atOffsets;
+
+static void printAt()
+{
+    std::cout << "sampling instants (offset from requested time in ms):\n"
+              << std::fixed << std::setprecision(3);
+    for (const auto& [at, offs] : atOffsets) {
+        auto [mn, mx] = std::minmax_element(offs.begin(), offs.end());
+        std::cout << "  " << offs.size() << " NODs: min " << *mn * 1e-3 << " max "
+                  << *mx * 1e-3 << " spread " << (*mx - *mn) * 1e-3 << "\n";
+    }
+}
+
+static void finish()
+{
+    if (! meshRows.empty()) {
+        printMesh();
+    }
+    if (! atOffsets.empty()) {
+        printAt();
+    }
+    if (nTraced > 0) {
+        std::cout << "mean of " << nTraced << " traced replies (in sec.):";
+        for (size_t i = 0; i < sums.size(); ++i) {
+            std::cout << " " << spanName[i] << "=" << sums[i] / nTraced;
+        }
+        std::cout << std::endl;
+    }
+    exit(0);
+}
+
+
+/*
+ * printReply prints a reply to a 'ptype' command (and collects what's
+ * summarized on exit).
+ */
+static void printReply(const Reply& pub, const std::string& ptype)
+{
+    auto [out, trailer] = ReplyTrailer::split(pub.getContent());
+    if (! trace && atDelay == atDelay.zero()) {
+        out = std::string_view((const char*)pub.getContent().value(),
+                               pub.getContent().value_size());
+    }
+    if (out.size() > 0) {
+        std::cout << out << "\n";
+    }
+    if (ptype == "NodMesh") {
+        addMeshRow(pub["rSrcId"].toUri(), out);
     }
 
     // Using the reply timestamps to print client-to-nod & nod-to-client times
     std::cout << "Reply from " << pub["rSrcId"] << ": timing (in sec.): "
               << "to NOD=" + to_string(pub.timeDelta("rTS", "cTS"))
               << "  from NOD=" + to_string(pub.timeDelta("rTS")) << std::endl;
+    if (auto t = trailer.find(ReplyTrailer::trace); trace && t != trailer.end()) {
+        if (auto ts = TraceSpans::decode(t->second); ts) {
+            printTrace(pub, *ts);
+        }
+    }
+    if (auto t = trailer.find(ReplyTrailer::at); t != trailer.end()) {
+        if (auto at = ReplyTrailer::decodeAt(t->second); at) {
+            auto off = at->second - at->first;
+            std::cout << "  sampled " << off * 1e-3 << " ms after requested time" << std::endl;
+            atOffsets[at->first].push_back(off);
+        }
+    }
+}
+
+/*
+ * processReply handles each reply to a NOD probe command.
+ * It's a callback set in the call to issueCmd.
+ */
+void processReply(const Reply& pub, CRshim&)
+{
+    printReply(pub, ptype);
 }
 
 /*
@@ -107,15 +283,179 @@ void processReply(const Reply& pub, CRshim& shim)
  */
 void sendCommand(CRshim& shim)
 {
-    shim.issueCmd(ptype, pargs, processReply);
+    // NODs can drop this command once we've stopped listening for its replies
+    auto listen = interval * (count - 1) + replyWait + atDelay;
+    CmdOpts opts{{"dl", std::to_string(
+                boost::chrono::duration_cast<boost::chrono::milliseconds>(listen).count())}};
+    if (trace) {
+        opts["tr"] = "1";
+    }
+    if (atDelay > atDelay.zero()) {
+        auto at = std::chrono::system_clock::now() + std::chrono::nanoseconds(atDelay.count());
+        opts["at"] = std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(
+                                        at.time_since_epoch()).count());
+    }
+    shim.issueCmd(ptype, pargs, processReply, opts);
     if (--count > 0) {
         // wait then launch another command
         timer = shim.schedule(interval, [&shim](){ sendCommand(shim); });
     } else {
-        timer = shim.schedule(replyWait, [](){ exit(0); });
+        timer = shim.schedule(replyWait + atDelay, [](){ finish(); });
     }
 }
 
+/*
+ * Batch mode (-f) runs each line of a command file as its own job (target,
+ * probe, args, count, interval) with all the jobs going at once. Jobs with
+ * the same target share a CRshim (and all share one Face) and each
+ * command's replies go to its job. At most maxInFlight commands are
+ * listening for replies at a time: a command that's due when they all are
+ * waits for the first to finish. Each command listens for replyWait (plus
+ * atDelay) then stops and the process exits when every job's commands are
+ * done.
+ */
+struct Job {
+    int line;
+    std::string target;
+    std::string ptype;
+    std::string pargs;
+    int count{1};
+    ndn::time::nanoseconds interval{1_s};
+    CRshim* shim{};
+};
+
+static std::vector<Job> jobs;
+static std::map<std::string, std::unique_ptr<CRshim>> shims;
+static std::deque<Job*> waiting;      // jobs with a command due but no slot
+static int inFlight{};
+static int jobsSending{};             // jobs with commands left to send
+
+static void trySend(Job& j);
+
+static void jobDone()
+{
+    if (jobsSending == 0 && inFlight == 0 && waiting.empty()) {
+        finish();
+    }
+}
+
+static void sendJobCmd(Job& j)
+{
+    ++inFlight;
+    auto listen = replyWait + atDelay;
+    CmdOpts opts{{"dl", std::to_string(
+                boost::chrono::duration_cast<boost::chrono::milliseconds>(listen).count())}};
+    if (trace) {
+        opts["tr"] = "1";
+    }
+    if (atDelay > atDelay.zero()) {
+        auto at = std::chrono::system_clock::now() + std::chrono::nanoseconds(atDelay.count());
+        opts["at"] = std::to_string(std::chrono::duration_cast<std::chrono::microseconds>(
+                                        at.time_since_epoch()).count());
+    }
+    auto topic = j.shim->sendCmd(j.ptype, j.pargs, [&j](const Reply& r, CRshim&) {
+                    std::cout << "[" << j.line << "] " << j.ptype << " -t " << j.target << "\n";
+                    printReply(r, j.ptype);
+                }, opts);
+    if (debug) {
+        std::cerr << "[" << j.line << "] sent " << topic << "\n";
+    }
+    // (these timers are never cancelled: the process exits when all have run)
+    j.shim->schedule(listen, [&j, topic] {
+        j.shim->endCmd(topic);
+        --inFlight;
+        if (! waiting.empty()) {
+            auto w = waiting.front();
+            waiting.pop_front();
+            sendJobCmd(*w);
+        }
+        jobDone();
+    }).release();
+    if (--j.count > 0) {
+        j.shim->schedule(j.interval, [&j] { trySend(j); }).release();
+    } else {
+        --jobsSending;
+    }
+}
+
+static void trySend(Job& j)
+{
+    if (inFlight >= maxInFlight) {
+        waiting.push_back(&j);
+        return;
+    }
+    sendJobCmd(j);
+}
+
+// parse the command file into 'jobs' (throws on a bad line)
+static void readJobs(std::istream& is)
+{
+    int n = 0;
+    for (std::string line; std::getline(is, line); ) {
+        ++n;
+        std::istringstream ls(line);
+        Job j{n};
+        if (! (ls >> j.target) || j.target[0] == '#') {
+            continue;
+        }
+        std::string cnt, ival;
+        if (! (ls >> j.ptype)) {
+            throw std::runtime_error("line " + std::to_string(n) + ": no probe type");
+        }
+        ls >> j.pargs >> cnt >> ival;
+        if (j.pargs == "-") {
+            j.pargs.clear();
+        }
+        if (! cnt.empty()) {
+            int rint{};
+            if (auto [p,ec] = std::from_chars(cnt.data(), cnt.data() + cnt.size(), rint);
+                ec != std::errc() || rint < 1 || rint > 10000) {
+                throw std::runtime_error("line " + std::to_string(n) + ": bad count " + cnt);
+            }
+            j.count = rint;
+        }
+        if (! ival.empty()) {
+            double rdbl = std::strtod(ival.c_str(), nullptr);
+            if (rdbl < 0.01) {
+                throw std::runtime_error("line " + std::to_string(n) + ": bad interval " + ival);
+            }
+            j.interval = boost::chrono::nanoseconds((int64_t)(rdbl * 1e9));
+        }
+        jobs.push_back(std::move(j));
+    }
+}
+
+static void runBatch()
+{
+    if (batchFile == "-") {
+        readJobs(std::cin);
+    } else {
+        std::ifstream f(batchFile);
+        if (! f) {
+            throw std::runtime_error("can't open " + batchFile);
+        }
+        readJobs(f);
+    }
+    if (jobs.empty()) {
+        return;
+    }
+    // the first target's shim makes the Face the others share
+    CRshim* first{};
+    for (auto& j : jobs) {
+        auto& s = shims[j.target];
+        if (! s) {
+            s.reset(first? new CRshim(*first, j.target) : new CRshim(j.target));
+            first = first? first : s.get();
+        }
+        j.shim = s.get();
+    }
+    jobsSending = jobs.size();
+    for (auto& j : jobs) {
+        trySend(j);
+    }
+    first->run();
+}
+
 /*
  * Main for a Generic Client that passes the probe type and arguments
  * and prints the reply.
@@ -130,7 +470,7 @@ int main(int argc, char* argv[])
         return 1;
     }
     for (int c;
-         (c = getopt_long(argc, argv, "p:a:t:c:i:w:dh", opts, nullptr)) != -1;) {
+         (c = getopt_long(argc, argv, "p:a:t:c:i:w:TA:f:m:dh", opts, nullptr)) != -1;) {
         switch (c) {
             int rint;
             double rdbl;
@@ -161,6 +501,24 @@ int main(int argc, char* argv[])
                 replyWait = boost::chrono::nanoseconds((int)(rdbl * 1e9));
             }
             break;
+        case 'T':
+            trace = true;
+            break;
+        case 'A':
+            rdbl = std::stod(optarg);
+            if (rdbl > 0 && rdbl <= 60) {
+                atDelay = boost::chrono::nanoseconds((int64_t)(rdbl * 1e9));
+            }
+            break;
+        case 'f':
+            batchFile = optarg;
+            break;
+        case 'm':
+            if (auto [p,ec] = std::from_chars(optarg, optarg+strlen(optarg), rint);
+                ec == std::errc() && rint >= 1) {
+                maxInFlight = rint;
+            }
+            break;
         case 'd':
             ++debug;
             break;
@@ -169,12 +527,16 @@ int main(int argc, char* argv[])
             exit(0);
         }
     }
-    if (optind < argc || ptype.empty() || target.empty()) {
+    if (optind < argc || (ptype.empty() && batchFile.empty()) || target.empty()) {
         usage(argv[0]);
         return 1;
     }
 
     try {
+        if (! batchFile.empty()) {
+            runBatch();
+            return 0;
+        }
         // make a CRshim with this target
         CRshim s(target);
         // builds and publishes command and waits for reply
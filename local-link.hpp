@@ -0,0 +1,595 @@
+#ifndef LOCAL_LINK_HPP
+#define LOCAL_LINK_HPP
+/*
+ * local-link.hpp: shared memory command/reply transport between a NOD and
+ *                 clients on the same host
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * A NOD's LocalServer listens on a unix socket (localSockPath()) in a
+ * directory only the NOD's user can write, so no one else can take the
+ * socket's place, and a client only uses a socket whose server (checked
+ * with SO_PEERCRED) owns the directory. A client connects and sends a
+ * newline. The server takes its ID (the 'origin' of its commands) from the
+ * pid the kernel reports for the connection, not from anything the client
+ * says, refuses a second attach with the same ID and answers with three fds (passed with SCM_RIGHTS): a shared memory region
+ * holding a ring in each direction and an eventfd for each direction. The
+ * two ends' LocalLinks then exchange messages through the rings, each write
+ * followed by a bump of the peer's eventfd (which the peer waits on in its
+ * event loop), so a command and its reply never touch the forwarder.
+ *
+ * A message is a Name TLV followed by the content bytes. Commands and
+ * replies are carried unsigned: only processes on this host can use the
+ * link, the same trust as /localhost. The server hands each command to the
+ * NOD with the ID of the client it came on so the NOD can refuse commands
+ * whose origin isn't their sender.
+ * The socket stays open while the client is attached so the server sees it
+ * go away.
+ *
+ * Each ring is single producer, single consumer. A message that doesn't fit
+ * in the free space of a ring is refused (send() returns false). A client
+ * then falls back to sync for that command. The server instead holds the
+ * reply (and any after it) for the client: a producer that finds its ring
+ * full sets the ring's 'full' flag and the consumer, once it has drained
+ * the ring, clears the flag and bumps the producer's eventfd so the held
+ * replies go out in order. A client that lets too many replies back up is
+ * dropped. A client sees that (its socket closes) and moves what it was
+ * waiting for to sync. The peer can write the whole region so
+ * nothing read from it is trusted: a ring whose indices or record lengths
+ * don't add up kills the link (send() returns false from then on and the
+ * NOD drops the client).
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/types.h>
+#include <ndn-cxx/name.hpp>
+#include <boost/asio/io_service.hpp>
+
+/*
+ * unix socket where a NOD serves local clients ($DNMP_LOCAL_SOCK overrides).
+ * Its directory must belong to the NOD's user and not be writable by
+ * anyone else (the NOD creates it if it can; otherwise it has to be made
+ * for it, e.g., by systemd's RuntimeDirectory=dnmp).
+ */
+static inline std::string localSockPath()
+{
+    auto p = std::getenv("DNMP_LOCAL_SOCK");
+    return p? p : "/run/dnmp/local.sock";
+}
+
+#if defined(__linux__)
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+
+// true if 'path's directory is a directory owned by 'uid' that no one
+// else can write
+static inline bool sockDirOwnedBy(const std::string& path, uid_t uid)
+{
+    auto slash = path.rfind('/');
+    auto dir = slash == std::string::npos? std::string(".") :
+               slash == 0? std::string("/") : path.substr(0, slash);
+    struct stat st;
+    return ::lstat(dir.c_str(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_uid == uid &&
+           (st.st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+// the credentials of the process at the other end of unix socket 's'
+static inline bool peerCred(int s, ucred& cred)
+{
+    socklen_t len = sizeof(cred);
+    return ::getsockopt(s, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && len == sizeof(cred);
+}
+
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+
+/*
+ * Ring of length-prefixed records. 'head' and 'tail' are byte counts that
+ * only grow; only the producer writes head and only the consumer tail.
+ */
+struct ShmRing {
+    static constexpr size_t size = 1 << 21;
+
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    alignas(64) std::atomic<uint32_t> full;     // producer is waiting for space
+    alignas(64) uint8_t data[size];
+
+    bool put(std::string_view a, std::string_view b)
+    {
+        uint32_t n = a.size() + b.size();
+        auto h = head.load(std::memory_order_relaxed);
+        auto used = h - tail.load(std::memory_order_acquire);
+        if (used > size || size - used < sizeof(n) + n) {
+            // ask the consumer to say when it has drained then check again
+            // (it may have drained since we looked)
+            full.store(1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            used = h - tail.load(std::memory_order_acquire);
+            if (used > size || size - used < sizeof(n) + n) {
+                return false;
+            }
+        }
+        copyIn(h, &n, sizeof(n));
+        copyIn(h + sizeof(n), a.data(), a.size());
+        copyIn(h + sizeof(n) + a.size(), b.data(), b.size());
+        head.store(h + sizeof(n) + n, std::memory_order_release);
+        return true;
+    }
+
+    // call 'fn' with each record in the ring. Returns false (having read
+    // nothing more) if the ring is corrupt.
+    template<typename F>
+    bool drain(std::string& rec, F&& fn)
+    {
+        auto t = tail.load(std::memory_order_relaxed);
+        auto h = head.load(std::memory_order_acquire);
+        if (h - t > size) {
+            return false;
+        }
+        while (t != h) {
+            uint32_t n;
+            if (h - t < sizeof(n)) {
+                return false;
+            }
+            copyOut(t, &n, sizeof(n));
+            if (n > h - t - sizeof(n)) {
+                return false;
+            }
+            rec.resize(n);
+            copyOut(t + sizeof(n), rec.data(), n);
+            t += sizeof(n) + n;
+            tail.store(t, std::memory_order_release);
+            fn(std::string_view(rec));
+        }
+        return true;
+    }
+
+    // true if the producer was waiting for space (and now isn't)
+    bool takeFull()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return full.load(std::memory_order_relaxed) != 0 &&
+               full.exchange(0, std::memory_order_relaxed) != 0;
+    }
+
+  private:
+    void copyIn(uint64_t at, const void* p, size_t n)
+    {
+        auto o = at % size, k = std::min(n, size - o);
+        memcpy(data + o, p, k);
+        memcpy(data, (const uint8_t*)p + k, n - k);
+    }
+    void copyOut(uint64_t at, void* p, size_t n) const
+    {
+        auto o = at % size, k = std::min(n, size - o);
+        memcpy(p, data + o, k);
+        memcpy((uint8_t*)p + k, data, n - k);
+    }
+};
+
+struct ShmRegion {
+    ShmRing toNod;
+    ShmRing toClient;
+};
+
+class LocalLink
+{
+  public:
+    using OnMsg = std::function<void(const ndn::Name&, std::string_view content)>;
+
+    /*
+     * One end of a link. Takes ownership of the fds: the shared region,
+     * the eventfd it waits on, the peer's eventfd and (client end) the
+     * socket that keeps it attached.
+     */
+    LocalLink(boost::asio::io_service& io, int shmFd, int rxFd, int txFd, bool nodEnd,
+              OnMsg&& onMsg, int sock = -1)
+        : m_rx{io, rxFd}, m_txFd{txFd}, m_sock{io}, m_onMsg{std::move(onMsg)}
+    {
+        auto p = ::mmap(nullptr, sizeof(ShmRegion), PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+        ::close(shmFd);
+        if (p == MAP_FAILED) {
+            ::close(m_txFd);
+            if (sock >= 0) ::close(sock);
+            throw std::runtime_error(std::string("local link mmap: ") + strerror(errno));
+        }
+        m_region = (ShmRegion*)p;
+        m_in = nodEnd? &m_region->toNod : &m_region->toClient;
+        m_out = nodEnd? &m_region->toClient : &m_region->toNod;
+        wait();
+        if (sock >= 0) {
+            m_sock.assign(sock);
+            watchSock();
+        }
+    }
+    ~LocalLink()
+    {
+        m_rx.close();
+        m_sock.close();
+        ::munmap(m_region, sizeof(ShmRegion));
+        ::close(m_txFd);
+    }
+    LocalLink(const LocalLink&) = delete;
+    LocalLink& operator=(const LocalLink&) = delete;
+
+    bool isDead() const { return m_dead; }
+
+    // call 'cb' if the link dies
+    void onDead(std::function<void()>&& cb) { m_onDead = std::move(cb); }
+
+    // call 'cb' whenever the peer may have drained our ring
+    void onWritable(std::function<void()>&& cb) { m_onWritable = std::move(cb); }
+
+    bool send(const ndn::Name& n, std::string_view content)
+    {
+        const auto& w = n.wireEncode();
+        if (m_dead || ! m_out->put({(const char*)w.wire(), w.size()}, content)) {
+            return false;
+        }
+        signal();
+        return true;
+    }
+
+    /*
+     * Connect to the NOD serving 'path'. Returns null if there's no NOD
+     * serving local clients there (or what's there isn't the owner of the
+     * socket's directory).
+     */
+    static std::unique_ptr<LocalLink> connect(boost::asio::io_service& io, const std::string& path,
+                                              OnMsg&& onMsg)
+    {
+        int s = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_un sa{};
+        sa.sun_family = AF_UNIX;
+        strncpy(sa.sun_path, path.c_str(), sizeof(sa.sun_path) - 1);
+        timeval tv{1, 0};
+        setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ucred cred{};
+        int fds[3];
+        if (s < 0 || ::connect(s, (sockaddr*)&sa, sizeof(sa)) < 0 || ! peerCred(s, cred) ||
+                ! (sockDirOwnedBy(path, cred.uid) || sockDirOwnedBy(path, 0)) ||
+                ::write(s, "\n", 1) != 1 || ! recvFds(s, fds)) {
+            if (s >= 0) ::close(s);
+            return nullptr;
+        }
+        // the server sends: region, eventfd to the NOD, eventfd to the client
+        return std::make_unique<LocalLink>(io, fds[0], fds[2], fds[1], false, std::move(onMsg), s);
+    }
+
+  private:
+    void wait()
+    {
+        m_rx.async_read_some(boost::asio::null_buffers(), [this](const auto& ec, size_t) {
+            if (ec) {
+                return;
+            }
+            uint64_t v;
+            if (::read(m_rx.native_handle(), &v, sizeof(v)) < 0) {
+                // (nothing to read: the ring is drained anyway)
+            }
+            if (! m_in->drain(m_rec, [this](std::string_view r) { deliver(r); })) {
+                dead();
+                return;
+            }
+            if (m_in->takeFull()) {
+                signal();
+            }
+            if (m_onWritable) {
+                m_onWritable();
+            }
+            wait();
+        });
+    }
+
+    // wake the peer
+    void signal()
+    {
+        uint64_t one = 1;
+        if (::write(m_txFd, &one, sizeof(one)) < 0) {
+            // (only fails if the count would overflow, when the peer is
+            // already due to wake)
+        }
+    }
+
+    // (client end) the server never writes the socket after attaching so
+    // its becoming readable means the server has gone or dropped us
+    void watchSock()
+    {
+        m_sock.async_read_some(boost::asio::null_buffers(), [this](const auto& ec, size_t) {
+            if (ec != boost::asio::error::operation_aborted) {
+                dead();
+            }
+        });
+    }
+
+    // the peer corrupted the region: stop using the link
+    void dead()
+    {
+        if (m_dead) {
+            return;
+        }
+        m_dead = true;
+        if (m_onDead) {
+            // (may destroy this link so must be last)
+            auto cb = std::move(m_onDead);
+            cb();
+        }
+    }
+
+    void deliver(std::string_view r)
+    {
+        auto [ok, b] = ndn::Block::fromBuffer((const uint8_t*)r.data(), r.size());
+        if (! ok || b.type() != ndn::tlv::Name) {
+            return;
+        }
+        m_onMsg(ndn::Name(b), r.substr(b.size()));
+    }
+
+    static bool recvFds(int s, int (&fds)[3])
+    {
+        char c;
+        iovec iov{&c, 1};
+        alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(fds))];
+        msghdr m{};
+        m.msg_iov = &iov;
+        m.msg_iovlen = 1;
+        m.msg_control = buf;
+        m.msg_controllen = sizeof(buf);
+        if (::recvmsg(s, &m, MSG_CMSG_CLOEXEC) != 1) {
+            return false;
+        }
+        auto cm = CMSG_FIRSTHDR(&m);
+        if (cm == nullptr || cm->cmsg_type != SCM_RIGHTS || cm->cmsg_len != CMSG_LEN(sizeof(fds))) {
+            return false;
+        }
+        memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+        return true;
+    }
+
+    boost::asio::posix::stream_descriptor m_rx;
+    int m_txFd;
+    boost::asio::posix::stream_descriptor m_sock;   // client end's socket
+    OnMsg m_onMsg;
+    ShmRegion* m_region{};
+    ShmRing* m_in{};
+    ShmRing* m_out{};
+    std::string m_rec{};
+    bool m_dead{false};
+    std::function<void()> m_onDead{};
+    std::function<void()> m_onWritable{};
+};
+
+class LocalServer
+{
+  public:
+    // a command from the client whose ID is 'id' (running as user 'uid')
+    using OnMsg = std::function<void(std::string_view id, uid_t uid, const ndn::Name&,
+                                     std::string_view content)>;
+    // the ID of the client process 'pid'
+    using IdOf = std::function<std::string(pid_t pid)>;
+    using stream = boost::asio::local::stream_protocol;
+
+    LocalServer(boost::asio::io_service& io, const std::string& path, IdOf&& idOf, OnMsg&& onMsg)
+        : m_io{io}, m_acceptor{io}, m_idOf{std::move(idOf)}, m_onMsg{std::move(onMsg)}
+    {
+        auto dir = path.substr(0, path.rfind('/'));
+        if (! dir.empty()) {
+            ::mkdir(dir.c_str(), 0755);
+        }
+        if (! sockDirOwnedBy(path, ::geteuid())) {
+            throw std::runtime_error("directory of " + path +
+                                     " must be ours and not writable by others");
+        }
+        ::unlink(path.c_str());
+        stream::endpoint ep(path);
+        m_acceptor.open(ep.protocol());
+        m_acceptor.bind(ep);
+        m_acceptor.listen();
+        accept();
+    }
+
+    static constexpr size_t maxBacklog = 1024;  // replies held for a client
+
+    // send to the attached client whose ID is 'id' (false if there's none).
+    // If its ring is full the message is held until there's room.
+    bool send(std::string_view id, const ndn::Name& n, std::string_view content)
+    {
+        for (const auto& c : m_clients) {
+            if (! c->link || c->id != id) {
+                continue;
+            }
+            if (c->backlog.empty() && c->link->send(n, content)) {
+                return true;
+            }
+            if (c->backlog.size() >= maxBacklog) {
+                // client isn't draining its ring: drop it (see hello())
+                c->sock.close();
+                return false;
+            }
+            c->backlog.emplace_back(n, std::string(content));
+            return true;
+        }
+        return false;
+    }
+    size_t clients() const { return m_clients.size(); }
+
+  private:
+    struct Client {
+        explicit Client(boost::asio::io_service& io) : sock{io} {}
+        stream::socket sock;
+        std::string id{};
+        uid_t uid{};
+        std::unique_ptr<LocalLink> link{};
+        std::deque<std::pair<ndn::Name, std::string>> backlog{};
+        std::array<char, 256> buf{};
+
+        void flush()
+        {
+            while (! backlog.empty() && link->send(backlog.front().first, backlog.front().second)) {
+                backlog.pop_front();
+            }
+        }
+    };
+
+    void accept()
+    {
+        auto c = std::make_shared<Client>(m_io);
+        m_acceptor.async_accept(c->sock, [this, c](const auto& ec) {
+            if (ec) {
+                return;
+            }
+            m_clients.push_back(c);
+            hello(c);
+            accept();
+        });
+    }
+
+    // read the client's hello then attach it, after which any read is its exit
+    void hello(const std::shared_ptr<Client>& c)
+    {
+        c->sock.async_read_some(boost::asio::buffer(c->buf), [this, c](const auto& ec, size_t n) {
+            if (ec || c->link || n != 1 || c->buf[0] != '\n' || ! attach(*c)) {
+                drop(c);
+                return;
+            }
+            hello(c);
+        });
+    }
+
+    bool attach(Client& c)
+    {
+        ucred cred{};
+        if (! peerCred(c.sock.native_handle(), cred)) {
+            return false;
+        }
+        auto id = m_idOf(cred.pid);
+        for (const auto& o : m_clients) {
+            if (o->link && o->id == id) {
+                return false;
+            }
+        }
+        int shm = ::memfd_create("dnmp-local", MFD_CLOEXEC);
+        int toNod = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        int toClient = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        int fds[3]{shm, toNod, toClient};
+        if (shm < 0 || toNod < 0 || toClient < 0 || ::ftruncate(shm, sizeof(ShmRegion)) < 0 ||
+                ! sendFds(c.sock.native_handle(), fds)) {
+            for (auto f : fds) if (f >= 0) ::close(f);
+            return false;
+        }
+        c.id = id;
+        c.uid = cred.uid;
+        c.link = std::make_unique<LocalLink>(m_io, shm, toNod, toClient, true,
+                        [this, &c](const auto& n, auto content) { m_onMsg(c.id, c.uid, n, content); });
+        // a client that corrupts its link is dropped (closing its socket
+        // ends the read in hello(), which drops it)
+        c.link->onDead([&c] { c.sock.close(); });
+        c.link->onWritable([&c] { c.flush(); });
+        return true;
+    }
+
+    void drop(const std::shared_ptr<Client>& c)
+    {
+        m_clients.erase(std::remove(m_clients.begin(), m_clients.end(), c), m_clients.end());
+    }
+
+    static bool sendFds(int s, const int (&fds)[3])
+    {
+        char c = 0;
+        iovec iov{&c, 1};
+        alignas(cmsghdr) char buf[CMSG_SPACE(sizeof(fds))]{};
+        msghdr m{};
+        m.msg_iov = &iov;
+        m.msg_iovlen = 1;
+        m.msg_control = buf;
+        m.msg_controllen = sizeof(buf);
+        auto cm = CMSG_FIRSTHDR(&m);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+        return ::sendmsg(s, &m, MSG_NOSIGNAL) == 1;
+    }
+
+    boost::asio::io_service& m_io;
+    stream::acceptor m_acceptor;
+    IdOf m_idOf;
+    OnMsg m_onMsg;
+    std::vector<std::shared_ptr<Client>> m_clients{};
+};
+
+#else   // no memfd/eventfd: there's never a local link
+
+class LocalLink
+{
+  public:
+    using OnMsg = std::function<void(const ndn::Name&, std::string_view content)>;
+
+    bool send(const ndn::Name&, std::string_view) { return false; }
+    bool isDead() const { return true; }
+    void onDead(std::function<void()>&&) {}
+
+    static std::unique_ptr<LocalLink> connect(boost::asio::io_service&, const std::string&,
+                                              OnMsg&&)
+    {
+        return nullptr;
+    }
+};
+
+class LocalServer
+{
+  public:
+    using OnMsg = std::function<void(std::string_view id, uid_t uid, const ndn::Name&,
+                                     std::string_view content)>;
+    using IdOf = std::function<std::string(pid_t pid)>;
+
+    LocalServer(boost::asio::io_service&, const std::string&, IdOf&&, OnMsg&&)
+    {
+        throw std::runtime_error("local links need Linux");
+    }
+    bool send(std::string_view, const ndn::Name&, std::string_view) { return false; }
+    size_t clients() const { return 0; }
+};
+
+#endif
+
+#endif // LOCAL_LINK_HPP
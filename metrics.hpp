@@ -0,0 +1,254 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+/*
+ * metrics.hpp: local metrics exposition for DNMP processes
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * A process registers the metrics it wants exported (counters, gauges and
+ * histograms, all atomics that the face thread updates with relaxed stores)
+ * then starts a MetricsServer. The server runs on its own thread and answers
+ * each HTTP request on its socket (TCP on localhost or a unix socket) with
+ * a snapshot of the metrics in Prometheus text exposition format, so scrapes
+ * never block or wait for the sync event loop.
+ *
+ * Metrics must all be registered before the server is started.
+ */
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Counter = std::atomic<uint64_t>;
+using Gauge = std::atomic<int64_t>;
+
+static inline void bump(Counter& c, uint64_t n = 1) { c.fetch_add(n, std::memory_order_relaxed); }
+static inline void setGauge(Gauge& g, int64_t v) { g.store(v, std::memory_order_relaxed); }
+
+/*
+ * Histogram with fixed bucket upper bounds in seconds (roughly x2.5 steps
+ * from 100us to 10s) and an implicit +Inf bucket.
+ */
+class Histogram
+{
+  public:
+    static constexpr std::array<double, 12> bounds{
+        .0001, .00025, .0005, .001, .0025, .005, .01, .025, .05, .1, 1, 10};
+
+    void observe(double sec)
+    {
+        size_t i = 0;
+        while (i < bounds.size() && sec > bounds[i]) ++i;
+        m_bucket[i].fetch_add(1, std::memory_order_relaxed);
+        // sum kept in ns so it can be an integer atomic
+        m_sumNs.fetch_add(uint64_t(sec * 1e9), std::memory_order_relaxed);
+    }
+
+    void render(std::ostream& os, const std::string& name, const std::string& labels) const
+    {
+        uint64_t cum{};
+        auto sep = labels.empty()? "" : ",";
+        for (size_t i = 0; i <= bounds.size(); ++i) {
+            cum += m_bucket[i].load(std::memory_order_relaxed);
+            os << name << "_bucket{" << labels << sep << "le=\"";
+            if (i < bounds.size()) os << bounds[i]; else os << "+Inf";
+            os << "\"} " << cum << "\n";
+        }
+        auto lb = labels.empty()? "" : "{" + labels + "}";
+        os << name << "_sum" << lb << " " << m_sumNs.load(std::memory_order_relaxed) * 1e-9 << "\n"
+           << name << "_count" << lb << " " << cum << "\n";
+    }
+
+  private:
+    std::array<std::atomic<uint64_t>, bounds.size() + 1> m_bucket{};
+    std::atomic<uint64_t> m_sumNs{};
+};
+
+class MetricsRegistry
+{
+  public:
+    // labels are in exposition syntax, e.g., R"(group="/localhost/dnmp")"
+    MetricsRegistry& counter(const std::string& name, const std::string& help,
+                             const Counter& c, const std::string& labels = "")
+    {
+        add(name, help, "counter", labels, [&c](std::ostream& os, const std::string& n,
+                                                const std::string& l) {
+            os << n << l << " " << c.load(std::memory_order_relaxed) << "\n"; });
+        return *this;
+    }
+    template<typename T>
+    MetricsRegistry& gauge(const std::string& name, const std::string& help,
+                           const std::atomic<T>& g, const std::string& labels = "")
+    {
+        add(name, help, "gauge", labels, [&g](std::ostream& os, const std::string& n,
+                                              const std::string& l) {
+            os << n << l << " " << g.load(std::memory_order_relaxed) << "\n"; });
+        return *this;
+    }
+    // gauge whose value is computed at scrape time (on the server's thread)
+    MetricsRegistry& gauge(const std::string& name, const std::string& help,
+                           std::function<double()> fn, const std::string& labels = "")
+    {
+        add(name, help, "gauge", labels, [fn](std::ostream& os, const std::string& n,
+                                              const std::string& l) {
+            os << n << l << " " << fn() << "\n"; });
+        return *this;
+    }
+    MetricsRegistry& histogram(const std::string& name, const std::string& help,
+                               const Histogram& h, const std::string& labels = "")
+    {
+        m_items.push_back({name, help, "histogram", labels,
+            [&h, labels](std::ostream& os, const std::string& n, const std::string&) {
+                h.render(os, n, labels); }});
+        return *this;
+    }
+
+    std::string render() const
+    {
+        std::ostringstream os;
+        const std::string* last{};
+        for (const auto& i : m_items) {
+            // HELP and TYPE once per metric family
+            if (last == nullptr || *last != i.name) {
+                os << "# HELP " << i.name << " " << i.help << "\n"
+                   << "# TYPE " << i.name << " " << i.type << "\n";
+            }
+            last = &i.name;
+            i.fn(os, i.name, i.labels.empty()? "" : "{" + i.labels + "}");
+        }
+        return os.str();
+    }
+
+  private:
+    using RenderFn = std::function<void(std::ostream&, const std::string&, const std::string&)>;
+    struct Item {
+        std::string name;
+        std::string help;
+        const char* type;
+        std::string labels;
+        RenderFn fn;
+    };
+    void add(const std::string& name, const std::string& help, const char* type,
+             const std::string& labels, RenderFn&& fn)
+    {
+        m_items.push_back({name, help, type, labels, std::move(fn)});
+    }
+
+    std::vector<Item> m_items{};
+};
+
+/*
+ * Serve a registry's metrics on 'where': a port number (TCP on 127.0.0.1)
+ * or a unix socket path. Scrapes are served one at a time so a scraper
+ * that stalls is cut off after ioTimeout.
+ */
+class MetricsServer
+{
+  public:
+    MetricsServer(const MetricsRegistry& reg, const std::string& where) : m_reg{reg}
+    {
+        bool isPort = !where.empty() &&
+                      where.find_first_not_of("0123456789") == std::string::npos;
+        m_fd = socket(isPort? AF_INET : AF_UNIX, SOCK_STREAM, 0);
+        if (m_fd < 0) {
+            throw std::runtime_error(std::string("metrics socket: ") + strerror(errno));
+        }
+        int r;
+        if (isPort) {
+            int on = 1;
+            setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            sockaddr_in sa{};
+            sa.sin_family = AF_INET;
+            sa.sin_port = htons(std::stoi(where));
+            sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            r = bind(m_fd, (sockaddr*)&sa, sizeof(sa));
+        } else {
+            sockaddr_un sa{};
+            sa.sun_family = AF_UNIX;
+            strncpy(sa.sun_path, where.c_str(), sizeof(sa.sun_path) - 1);
+            // only replace a stale socket (anything else makes bind fail)
+            struct stat st;
+            if (lstat(sa.sun_path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+                unlink(sa.sun_path);
+            }
+            r = bind(m_fd, (sockaddr*)&sa, sizeof(sa));
+        }
+        if (r < 0 || listen(m_fd, 8) < 0) {
+            close(m_fd);
+            throw std::runtime_error("metrics bind " + where + ": " + strerror(errno));
+        }
+        std::thread([this] { serve(); }).detach();
+    }
+
+  private:
+    static constexpr timeval ioTimeout{2, 0};
+
+    void serve()
+    {
+        for (;;) {
+            int c = accept(m_fd, nullptr, nullptr);
+            if (c < 0) {
+                if (errno == EINTR) continue;
+                return;
+            }
+            setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &ioTimeout, sizeof(ioTimeout));
+            setsockopt(c, SOL_SOCKET, SO_SNDTIMEO, &ioTimeout, sizeof(ioTimeout));
+            // read (and ignore) the request then send the current snapshot
+            char req[2048];
+            if (read(c, req, sizeof(req)) < 0) {
+                // (timed out or reset: nothing to answer)
+                close(c);
+                continue;
+            }
+            auto body = m_reg.render();
+            auto rsp = "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+            for (size_t off = 0; off < rsp.size(); ) {
+                auto n = send(c, rsp.data() + off, rsp.size() - off, MSG_NOSIGNAL);
+                if (n <= 0) break;
+                off += n;
+            }
+            close(c);
+        }
+    }
+
+    const MetricsRegistry& m_reg;
+    int m_fd{-1};
+};
+
+#endif // METRICS_HPP
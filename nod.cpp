@@ -27,11 +27,25 @@
  */
 
 #include <getopt.h>
+#include <malloc.h>
 #include <unistd.h>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
 #include <functional>
+#include <iomanip>
 #include <iostream>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+#include <sstream>
 #include <random>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+#include <boost/asio/signal_set.hpp>
 
 #include "CRshim.hpp"      //DNMP command-reply shim
 
@@ -42,43 +56,988 @@
  */
 
 #include "probes.hpp"
+#include "probe-registry.hpp"
+#include "probe-sched.hpp"
+#include "metrics.hpp"
+#include "procfs.hpp"
+#include "echo-mesh.hpp"
+#include "tput.hpp"
+#include "prefix-ping.hpp"
+#include "watch.hpp"
 
-using pb_f = std::function<std::string(const std::string&)>;
+/*
+ * Pending probe work, queued by the role of the command's issuer.
+ * The 'NodSched' probe reports the per-role queueing stats.
+ */
+static ProbeSched sched;
+static Timer schedTimer;
+
+/*
+ * Work avoided by not running commands whose deadline passed, either
+ * before they were queued or while waiting in the queue. The probe time
+ * saved is estimated from each probe's recent run time.
+ */
+static struct {
+    Counter late{};         // expired on arrival
+    Counter queued{};       // expired while queued
+    double savedMs{};
+} expired;
+
+// queue depths by role (for the metrics exporter)
+static std::array<Gauge, roleName.size()> queueDepth{};
+
+static void updateDepths()
+{
+    for (size_t r = 0; r < queueDepth.size(); ++r) {
+        setGauge(queueDepth[r], sched.depth(Role(r)));
+    }
+}
+
+static std::unordered_map<std::string_view, double> probeMs;
+
+static std::string schedProbe(const std::string& args)
+{
+    std::ostringstream s;
+    s << sched.stats() << "expired commands: on arrival " << expired.late
+      << " while queued " << expired.queued << " probe time saved (ms) "
+      << std::fixed << std::setprecision(3) << expired.savedMs << "\n";
+    return s.str();
+}
+
+/*
+ * Sync groups of this NOD's shims (set up in main). The 'SyncEvents'
+ * probe (or a SIGUSR1) dumps their flight recorders: the most recent
+ * 'args' (default 100) sync events of each.
+ */
+static std::vector<std::pair<std::string, const SyncPubsub*>> syncGroups;
+
+static std::string syncEventsProbe(const std::string& args)
+{
+    size_t n = 100;
+    if (!args.empty()) {
+        std::from_chars(args.data(), args.data() + args.size(), n);
+    }
+    std::string res;
+    for (const auto& [pfx, sp] : syncGroups) {
+        res += pfx + ": " + sp->recorder().dump(n);
+    }
+    return res;
+}
+
+/*
+ * Event loop lag: how late a periodic tick runs (ms), i.e., how long
+ * events can wait behind the work the NOD is doing.
+ */
+static constexpr auto lagTickPeriod = std::chrono::milliseconds(100);
+static struct {
+    std::chrono::steady_clock::time_point due{};
+    double last{};
+    double ewma{};
+    double max{};
+} loopLag;
+static Timer lagTimer;
+
+static void lagTick(CRshim& shim)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (loopLag.due != decltype(loopLag.due){}) {
+        loopLag.last = std::max(std::chrono::duration<double, std::milli>(now - loopLag.due).count(), 0.);
+        loopLag.ewma += (loopLag.last - loopLag.ewma) / 8;
+        loopLag.max = std::max(loopLag.max, loopLag.last);
+    }
+    loopLag.due = now + lagTickPeriod;
+    lagTimer = shim.schedule(ndn::time::milliseconds(lagTickPeriod.count()),
+                             [&shim] { lagTick(shim); });
+}
+
+/*
+ * The 'NodSelf' probe reports the NOD's own resource use: CPU time, RSS,
+ * heap in use, open fds, event loop lag and the sizes of its sync state.
+ * The /proc/self files are opened at startup and reread with pread.
+ */
+static ProcFile selfStatFile("/proc/self/stat");
+static ProcDir selfFdDir("/proc/self/fd");
+
+static std::string nodSelfProbe(const std::string& args)
+{
+    static const double tick = 1. / sysconf(_SC_CLK_TCK);
+    static const long pageSize = sysconf(_SC_PAGESIZE);
+
+    SelfStat st{};
+    st.parse(selfStatFile.read());
+    auto mi = mallinfo2();
+    std::ostringstream s;
+    s << std::fixed << std::setprecision(2)
+      << "cpu(s): user " << st.utime * tick << " system " << st.stime * tick << "\n"
+      << "rss(KB): " << st.rss * pageSize / 1024 << "\n"
+      << "heap(KB): in use " << mi.uordblks / 1024 << " mapped " << mi.hblkhd / 1024
+      << " free " << mi.fordblks / 1024 << "\n"
+      << "threads: " << st.threads << "\n"
+      << "fds: " << selfFdDir.count() << "\n"
+      << std::setprecision(3) << "loop lag(ms): last " << loopLag.last
+      << " recent " << loopLag.ewma << " max " << loopLag.max << "\n"
+      << "queued commands: " << sched.depth() << "\n";
+    for (const auto& [pfx, sp] : syncGroups) {
+        const auto& ss = sp->stats();
+        s << pfx << ": active " << ss.activePubs << " subscriptions " << ss.subscriptions
+          << " pending interests " << ss.pendingInterests << "\n";
+    }
+    return s.str();
+}
+
+/*
+ * Timestamps of a command that asked to be traced ('tr' option). They're
+ * returned to the client as TraceSpans in the reply's trailer.
+ */
+struct CmdTrace {
+    using clock = std::chrono::steady_clock;
+    clock::time_point rcv{clock::now()};
+
+    uint32_t us(clock::time_point t) const { return us(t - rcv); }
+    static uint32_t us(clock::duration d)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    }
+};
+
+/*
+ * Context of an asynchronous probe: its command, the shim it came in on and
+ * what the command asked to have in its replies' trailers. A traced reply's
+ * spans run from the probe's start to the reply.
+ */
+struct ProbeCtx {
+    RName cmd;
+    CRshim& shim;
+    std::optional<CmdTrace> tr{};
+    CmdTrace::clock::time_point start{CmdTrace::clock::now()};
+    int64_t at{};       // requested start ('at' option, 0 if none)
+    int64_t ran{};      // actual start (us since the epoch)
+
+    void reply(std::string&& res) const
+    {
+        if (tr || at) {
+            ReplyTrailer t;
+            if (tr) {
+                auto now = CmdTrace::clock::now();
+                t[ReplyTrailer::trace] = TraceSpans{tr->us(start), tr->us(start), 0,
+                                                    tr->us(now), tr->us(now)}.encode();
+            }
+            if (at) {
+                t[ReplyTrailer::at] = ReplyTrailer::encodeAt(at, ran);
+            }
+            t.appendTo(res);
+        }
+        auto n = cmd;
+        shim.sendReply(n, std::move(res));
+    }
+};
+
+/*
+ * The 'NodMesh' probe measures the round trip time between this NOD and
+ * every other NOD that got the command (see echo-mesh.hpp) and replies with
+ * its row of the group's latency matrix. Its args are "count[,interval_ms]"
+ * (default "10,100"). It takes about count * interval + 1 sec.
+ */
+static std::map<std::string, std::unique_ptr<EchoMesh>> meshes;  // running, by command
+
+static void meshProbe(const std::string& args, ProbeCtx&& ctx)
+{
+    EchoMesh::Params p;
+    if (!args.empty()) {
+        auto e = args.data() + args.size();
+        auto [c, ec] = std::from_chars(args.data(), e, p.count);
+        if (ec == std::errc() && c < e && *c == ',') {
+            uint32_t ms{};
+            std::from_chars(c + 1, e, ms);
+            p.interval = std::chrono::milliseconds(std::max(ms, 10u));
+        }
+        p.count = std::clamp(p.count, 1u, 1000u);
+    }
+    auto run = ctx.cmd.str("origin") + "-" + std::to_string(ctx.cmd["cTS"].toNumber());
+    auto [m, isNew] = meshes.try_emplace(run);
+    if (! isNew) {
+        return;
+    }
+    auto& shim = ctx.shim;
+    m->second = std::make_unique<EchoMesh>(shim, run, p,
+                    [run, ctx = std::move(ctx)](std::string&& res) mutable {
+                        ctx.reply(std::move(res));
+                        meshes.erase(std::string(run));
+                    });
+    m->second->start();
+}
+
+/*
+ * Throughput probes. 'TputServe' (args "[secs]", default 30) serves
+ * generated Data under a temporary prefix for secs and replies with the
+ * prefix. 'TputPull' (args "prefix[,secs[,window[,size]]]", default 5 sec.,
+ * 16 Interests, 4096 bytes) pulls Data from a TputServe prefix and replies
+ * with the goodput, RTT percentiles and retransmissions.
+ */
+struct TputServing {
+    TputServer server;
+    Timer stop;
+};
+static std::map<ndn::Name, std::unique_ptr<TputServing>> tputServers;
+static std::map<ndn::Name, std::unique_ptr<TputClient>> tputClients;   // by command
+static uint32_t tputRuns{};
+
+// the 'n'th comma-separated field of 'args' (empty if there isn't one)
+static std::string_view argField(std::string_view args, size_t n)
+{
+    for (; n > 0; --n) {
+        auto c = args.find(',');
+        args = c == args.npos? std::string_view{} : args.substr(c + 1);
+    }
+    return args.substr(0, args.find(','));
+}
+
+static uint32_t argNum(std::string_view args, size_t n, uint32_t dflt)
+{
+    auto f = argField(args, n);
+    uint32_t v = dflt;
+    std::from_chars(f.data(), f.data() + f.size(), v);
+    return v;
+}
+
+static void tputServeProbe(const std::string& args, ProbeCtx&& ctx)
+{
+    auto secs = std::clamp(argNum(args, 0, 30), 1u, 3600u);
+    ndn::Name pfx("/localnet/dnmp/tput");
+    pfx.append(CRshim::myPID()).appendNumber(++tputRuns);
+    auto& ts = tputServers[pfx];
+    ts.reset(new TputServing{{ctx.shim.face(), pfx}, {}});
+    ts->stop = ctx.shim.schedule(ndn::time::seconds(secs), [pfx] { tputServers.erase(pfx); });
+    ts->server.start([pfx, secs, ctx = std::move(ctx)](bool ok) mutable {
+        if (! ok) {
+            ctx.reply("TputServe: can't register " + pfx.toUri());
+            // (not from inside the server's own callback)
+            if (auto t = tputServers.find(pfx); t != tputServers.end()) {
+                t->second->stop = ctx.shim.schedule(0_ms, [pfx] { tputServers.erase(pfx); });
+            }
+            return;
+        }
+        ctx.reply(pfx.toUri() + "\nserving for " + std::to_string(secs) + " sec.\n");
+    });
+}
+
+static void tputPullProbe(const std::string& args, ProbeCtx&& ctx)
+{
+    auto pfx = argField(args, 0);
+    if (pfx.empty()) {
+        ctx.reply("TputPull: needs a TputServe prefix");
+        return;
+    }
+    TputClient::Params p;
+    p.duration = std::chrono::seconds(std::clamp(argNum(args, 1, 5), 1u, 600u));
+    p.window = std::clamp(argNum(args, 2, p.window), 1u, 1024u);
+    p.size = std::min<size_t>(argNum(args, 3, p.size), TputServer::maxSize);
+    auto cmd = ctx.cmd;
+    auto& shim = ctx.shim;
+    auto [it, isNew] = tputClients.try_emplace(cmd);
+    if (! isNew) {
+        // (a duplicate of a command that's running)
+        return;
+    }
+    auto& c = it->second = std::make_unique<TputClient>(shim.face(), ndn::Name(std::string(pfx)), p,
+                    [cmd, ctx = std::move(ctx)](TputClient::Result&& r) mutable {
+                        ctx.reply(r.str());
+                        tputClients.erase(ndn::Name(cmd));
+                    });
+    c->start();
+}
+
+/*
+ * The 'SizeSweep' probe measures latency and loss by Data size from this
+ * NOD to the NOD serving a TputServe prefix. Its args are
+ * "prefix[,count[,size:size:...]]" (default 20 Data of each of 256, 512,
+ * 1024, 1300, 2048, 4096, 6000 and 8000 bytes).
+ */
+static std::map<ndn::Name, std::unique_ptr<SizeSweep>> sweeps;   // by command
+
+static void sizeSweepProbe(const std::string& args, ProbeCtx&& ctx)
+{
+    auto pfx = argField(args, 0);
+    if (pfx.empty()) {
+        ctx.reply("SizeSweep: needs a TputServe prefix");
+        return;
+    }
+    SizeSweep::Params p;
+    p.count = std::clamp(argNum(args, 1, p.count), 1u, 1000u);
+    if (auto sz = argField(args, 2); ! sz.empty()) {
+        p.sizes.clear();
+        for (auto b = sz.data(), e = b + sz.size(); b < e; ++b) {
+            size_t v{};
+            b = std::from_chars(b, e, v).ptr;
+            if (v > 0) {
+                p.sizes.push_back(std::min(v, TputServer::maxSize));
+            }
+        }
+    }
+    auto cmd = ctx.cmd;
+    auto& face = ctx.shim.face();
+    auto [it, isNew] = sweeps.try_emplace(cmd);
+    if (! isNew) {
+        // (a duplicate of a command that's running)
+        return;
+    }
+    auto& sw = it->second = std::make_unique<SizeSweep>(face, ndn::Name(std::string(pfx)), p,
+                    [cmd, ctx = std::move(ctx)](SizeSweep::Result&& r) mutable {
+                        ctx.reply(r.str());
+                        sweeps.erase(ndn::Name(cmd));
+                    });
+    sw->start();
+}
+
+/*
+ * The 'PrefixPing' probe pings a name prefix from this NOD (see
+ * prefix-ping.hpp). Its args are "prefix[,rate_hz[,secs]]" (default 10 Hz
+ * for 5 sec.) and it replies when the last Interest is answered or times out.
+ */
+static std::map<ndn::Name, std::unique_ptr<PrefixPing>> pings;    // by command
 
-const static std::unordered_map<std::string, pb_f> probeTable = {
-    {"perNFDGS"s, periodicProbe},
-    {"NFDStrategy"s, nfdStrategyProbe},
-    {"NFDRIB"s, nfdRIBProbe},
-    {"NFDGeneralStatus"s, nfdGSProbe},
-    {"NFDFaceStatus"s, nfdFSProbe},
-    {"Pinger"s, echoProbe}
+static void prefixPingProbe(const std::string& args, ProbeCtx&& ctx)
+{
+    auto pfx = argField(args, 0);
+    if (pfx.empty()) {
+        ctx.reply("PrefixPing: needs a prefix");
+        return;
+    }
+    PrefixPing::Params p;
+    p.rate = std::clamp(argNum(args, 1, 10), 1u, 20000u);
+    p.duration = std::chrono::seconds(std::clamp(argNum(args, 2, 5), 1u, 600u));
+    auto cmd = ctx.cmd;
+    auto& face = ctx.shim.face();
+    auto [it, isNew] = pings.try_emplace(cmd);
+    if (! isNew) {
+        // (a duplicate of a command that's running)
+        return;
+    }
+    auto& pp = it->second = std::make_unique<PrefixPing>(face, ndn::Name(std::string(pfx)), p,
+                    [cmd, ctx = std::move(ctx)](PrefixPing::Result&& r) mutable {
+                        ctx.reply(r.str());
+                        pings.erase(ndn::Name(cmd));
+                    });
+    pp->start();
+}
+
+/*
+ * The 'Watch' probe evaluates a threshold condition on a metric locally (see
+ * watch.hpp) and replies only when the condition changes state, then once
+ * more when the watch ends. Its args are
+ *   "metric,>|<,threshold[,hysteresis[,period_ms[,secs]]]"
+ * (default no hysteresis, 1000 ms, 60 sec.) where a metric prefixed by
+ * "rate:" watches its per-second rate of change. Metrics are:
+ *   nfd.pit nfd.fib nfd.cs nfd.interests.in nfd.interests.out nfd.nacks.in
+ *   nfd.nacks.out nfd.unsatisfied   NFD general status counts
+ *   nfd.face@<faceid>               1 if the face exists, else 0
+ *   net.<field>@<interface>         /proc/net/dev counts, field one of
+ *                                   rxbytes rxpackets rxerrs rxdrop txbytes
+ *                                   txpackets txerrs txdrop
+ *   net.carrier@<interface>         1 if the interface has carrier, else 0
+ *   snmp.<Proto>.<Field>            /proc/net/snmp counts, e.g., snmp.Tcp.RetransSegs
+ *   nod.lag nod.queue               event loop lag (ms) and queued commands
+ * At most maxWatches run at once and nfd.* metrics are sampled no more
+ * often than nfdPollPeriod.
+ */
+static std::map<ndn::Name, std::unique_ptr<Watch>> watches;   // by command
+static constexpr size_t maxWatches = 64;
+
+/*
+ * An NFD dataset sampled by nfd.* watches. The fetch blocks the face thread
+ * so all the watches share one fetch per nfdPollPeriod and, after a fetch
+ * that gets nothing (NFD isn't answering), there's none for nfdPollBackoff.
+ */
+static constexpr auto nfdPollPeriod = std::chrono::milliseconds(1000);
+static constexpr auto nfdPollBackoff = std::chrono::seconds(10);
+
+struct NfdPoll {
+    const char* dataset;
+    std::chrono::steady_clock::time_point next{};
+    std::optional<ndn::Block> content{};
+
+    const std::optional<ndn::Block>& get()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now < next) {
+            return content;
+        }
+        ndn::nfdManagementQ fetcher;
+        fetcher.run(dataset);
+        if (fetcher.segments() == 0) {
+            content.reset();
+            next = now + nfdPollBackoff;
+        } else {
+            content = fetcher.content();
+            next = now + nfdPollPeriod;
+        }
+        return content;
+    }
 };
+static NfdPoll nfdStatusPoll{"/localhost/nfd/status/general"};
+static NfdPoll nfdFacesPoll{"/localhost/nfd/faces/list"};
+
+static std::optional<Watch::Sampler> watchSampler(std::string_view metric)
+{
+    using ndn::nfd::ForwarderStatus;
+    static const std::map<std::string_view, std::function<double(const ForwarderStatus&)>> nfdGS{
+        {"nfd.pit", [](const auto& s) { return s.getNPitEntries(); }},
+        {"nfd.fib", [](const auto& s) { return s.getNFibEntries(); }},
+        {"nfd.cs", [](const auto& s) { return s.getNCsEntries(); }},
+        {"nfd.interests.in", [](const auto& s) { return s.getNInInterests(); }},
+        {"nfd.interests.out", [](const auto& s) { return s.getNOutInterests(); }},
+        {"nfd.nacks.in", [](const auto& s) { return s.getNInNacks(); }},
+        {"nfd.nacks.out", [](const auto& s) { return s.getNOutNacks(); }},
+        {"nfd.unsatisfied", [](const auto& s) { return s.getNUnsatisfiedInterests(); }},
+    };
+    static const std::map<std::string_view, uint64_t NetDevStats::*> netDev{
+        {"rxbytes", &NetDevStats::rxBytes}, {"rxpackets", &NetDevStats::rxPackets},
+        {"rxerrs", &NetDevStats::rxErrs}, {"rxdrop", &NetDevStats::rxDrop},
+        {"txbytes", &NetDevStats::txBytes}, {"txpackets", &NetDevStats::txPackets},
+        {"txerrs", &NetDevStats::txErrs}, {"txdrop", &NetDevStats::txDrop},
+    };
+    auto at = metric.find('@');
+    auto name = metric.substr(0, at);
+    auto qual = at == metric.npos? std::string_view{} : metric.substr(at + 1);
+
+    if (auto g = nfdGS.find(name); g != nfdGS.end()) {
+        return [get = g->second]() -> std::optional<double> {
+            const auto& c = nfdStatusPoll.get();
+            if (! c) {
+                return std::nullopt;
+            }
+            return get(ForwarderStatus(*c));
+        };
+    }
+    if (name == "nfd.face" && ! qual.empty()) {
+        uint64_t id{};
+        auto [end, ec] = std::from_chars(qual.data(), qual.data() + qual.size(), id);
+        if (ec != std::errc() || end != qual.data() + qual.size()) {
+            return std::nullopt;
+        }
+        return [id]() -> std::optional<double> {
+            // (no face list isn't the face being gone)
+            const auto& c = nfdFacesPoll.get();
+            if (! c) {
+                return std::nullopt;
+            }
+            for (const auto& f : parseDatasetVector<ndn::nfd::FaceStatus>(
+                                        *c, ndn::tlv::nfd::FaceStatus)) {
+                if (f.getFaceId() == id) {
+                    return 1.;
+                }
+            }
+            return 0.;
+        };
+    }
+    if (name == "net.carrier" && ! qual.empty()) {
+        auto f = std::make_shared<ProcFile>(("/sys/class/net/" + std::string(qual) + "/carrier").c_str());
+        // (reading carrier fails while the interface is down)
+        return [f]() -> std::optional<double> { return f->read().substr(0, 1) == "1"? 1. : 0.; };
+    }
+    if (name.substr(0, 4) == "net." && ! qual.empty()) {
+        auto d = netDev.find(name.substr(4));
+        if (d == netDev.end()) {
+            return std::nullopt;
+        }
+        return [m = d->second, ifn = std::string(qual)]() {
+            std::optional<double> v;
+            NetDevStats::parse(netDevFile.read(), [&](const NetDevStats& s) {
+                if (s.name == ifn) v = s.*m;
+            });
+            return v;
+        };
+    }
+    if (name.substr(0, 5) == "snmp.") {
+        auto pf = name.substr(5);
+        for (const auto& f : SnmpStats::fields) {
+            if (pf.size() == f.proto.size() + 1 + f.name.size() && pf.substr(0, f.proto.size()) == f.proto
+                    && pf[f.proto.size()] == '.' && pf.substr(f.proto.size() + 1) == f.name) {
+                return [m = f.val]() -> std::optional<double> {
+                    SnmpStats st{};
+                    st.parse(netSnmpFile.read());
+                    return st.*m;
+                };
+            }
+        }
+        return std::nullopt;
+    }
+    if (name == "nod.lag") {
+        return []() -> std::optional<double> { return loopLag.last; };
+    }
+    if (name == "nod.queue") {
+        return []() -> std::optional<double> { return sched.depth(); };
+    }
+    return std::nullopt;
+}
+
+static void watchProbe(const std::string& args, ProbeCtx&& ctx)
+{
+    auto metric = argField(args, 0);
+    auto cmp = argField(args, 1);
+    auto thr = argField(args, 2);
+    Watch::Params p;
+    p.rate = metric.substr(0, 5) == "rate:";
+    if (p.rate) {
+        metric.remove_prefix(5);
+    }
+    // the threshold and hysteresis can be fractional
+    auto num = [](std::string_view f, double& v) {
+        std::string s(f);
+        char* e;
+        v = std::strtod(s.c_str(), &e);
+        return ! s.empty() && *e == 0;
+    };
+    if (watches.size() >= maxWatches) {
+        ctx.reply("Watch: too many watches running");
+        return;
+    }
+    auto sampler = watchSampler(metric);
+    if (! sampler || (cmp != ">" && cmp != "<") || ! num(thr, p.threshold)) {
+        ctx.reply("Watch: needs metric,>|<,threshold[,hysteresis[,period_ms[,secs]]]");
+        return;
+    }
+    p.above = cmp == ">";
+    if (! num(argField(args, 3), p.hysteresis) || p.hysteresis < 0) {
+        p.hysteresis = 0;
+    }
+    p.period = std::chrono::milliseconds(std::clamp(argNum(args, 4, 1000), 10u, 3600000u));
+    if (metric.substr(0, 4) == "nfd.") {
+        p.period = std::max(p.period, std::chrono::milliseconds(nfdPollPeriod));
+    }
+    p.duration = std::chrono::seconds(std::clamp(argNum(args, 5, 60), 1u, 86400u));
+
+    auto what = std::string(metric) + " " + Watch::str(p);
+    auto cmd = ctx.cmd;
+    auto& shim = ctx.shim;
+    auto& w = watches[cmd] = std::make_unique<Watch>(shim.ioService(), std::move(*sampler), p,
+                    [what, ctx](bool state, double v) {
+                        // (each reply gets its own copy of the command name)
+                        ctx.reply(what + (state? " TRIGGERED" : " CLEARED")
+                                  + " value " + std::to_string(v) + "\n");
+                    },
+                    [what, cmd, ctx](uint32_t changes) mutable {
+                        ctx.reply(what + " watch ended after " + std::to_string(changes)
+                                  + " changes\n");
+                        watches.erase(ndn::Name(cmd));
+                    });
+    w->start();
+}
+
+static void dumpOnSignal(boost::asio::signal_set& sigs)
+{
+    sigs.async_wait([&sigs](const auto& ec, int) {
+        if (ec) {
+            return;
+        }
+        std::cerr << syncEventsProbe(std::to_string(FlightRecorder::size));
+        dumpOnSignal(sigs);
+    });
+}
+
+/*
+ * The probes this NOD offers. Columns are:
+ *  probeType, probe, cost, maxAge (ms), budget (ms), fan-out ok
+ * and, for probes that reply asynchronously, the async probe.
+ */
+static constexpr ProbeTable probeTable{std::array{
+    ProbeDesc{"perNFDGS", periodicProbe, ProbeCost::cheap, 0, 0, false},
+    ProbeDesc{"NFDStrategy", nfdStrategyProbe, ProbeCost::expensive, 5000, 3000, true},
+    ProbeDesc{"NFDRIB", nfdRIBProbe, ProbeCost::expensive, 1000, 3000, true},
+    ProbeDesc{"NFDGeneralStatus", nfdGSProbe, ProbeCost::moderate, 100, 2000, true},
+    ProbeDesc{"NFDFaceStatus", nfdFSProbe, ProbeCost::expensive, 500, 3000, true},
+    ProbeDesc{"NFDCsInfo", nfdCsInfoProbe, ProbeCost::moderate, 0, 2000, true},
+    ProbeDesc{"Pinger", echoProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"NodSched", schedProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"SyncEvents", syncEventsProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"NodSelf", nodSelfProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"HostNetDev", hostNetDevProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"HostSnmp", hostSnmpProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"HostStat", hostStatProbe, ProbeCost::cheap, 0, 1000, true},
+    ProbeDesc{"NodMesh", nullptr, ProbeCost::cheap, 0, 5000, true, meshProbe},
+    ProbeDesc{"TputServe", nullptr, ProbeCost::cheap, 0, 2000, false, tputServeProbe},
+    ProbeDesc{"TputPull", nullptr, ProbeCost::cheap, 0, 0, false, tputPullProbe},
+    ProbeDesc{"PrefixPing", nullptr, ProbeCost::cheap, 0, 0, true, prefixPingProbe},
+    ProbeDesc{"SizeSweep", nullptr, ProbeCost::cheap, 0, 0, false, sizeSweepProbe},
+    ProbeDesc{"Watch", nullptr, ProbeCost::cheap, 0, 0, true, watchProbe}
+}};
+
+// probe run time distributions (for the metrics exporter)
+static std::map<std::string_view, Histogram> probeLat = [] {
+    std::map<std::string_view, Histogram> m;
+    for (const auto& pd : probeTable) m[pd.name];
+    return m;
+}();
 
 static int debug{};
 
 /*
- * probeDispatch gets function from probeTable and passes the probe arguments.
- * For asynchronous probes, need a way to callback to shim method to publish reply.
- * This could require a different shim and different type of publication.
- * Asynchronous probes can publish a reply with the location of their output.
+ * Role of a command's issuer. XXX Until the trust schema supplies it, the
+ * role is derived from the command's ID component: IDs given with --operator
+ * (default uid0) are operators, other 'uid<n>' IDs are users and anything
+ * else is a guest.
  */
-static void probeDispatch(RName&& r, CRshim& shim)
+static std::set<std::string> operators{"uid0"};
+
+static Role roleOf(const RName& r)
+{
+    auto id = r.str("Id");
+    if (operators.count(id)) {
+        return Role::op;
+    }
+    return id.compare(0, 3, "uid") == 0? Role::user : Role::guest;
+}
+
+/*
+ * Results of cacheable probes, keyed by probeType + NUL + probeArgs, most
+ * recently used first. An entry is reused until its probe's maxAge has
+ * passed. The args come from clients so the cache holds at most maxCached
+ * results, dropping the least recently used.
+ */
+using steadyTP = std::chrono::steady_clock::time_point;
+struct CachedReply {
+    std::string key;
+    steadyTP expires;
+    std::string res;
+};
+static constexpr size_t maxCached = 256;
+static std::list<CachedReply> cachedReplies;
+static std::unordered_map<std::string_view, std::list<CachedReply>::iterator> replyCache;
+
+static std::string runProbe(const ProbeDesc& pd, const std::string& args)
+{
+    if (pd.maxAge == 0) {
+        return pd.fn(args);
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto key = std::string(pd.name) + '\0' + args;
+    if (auto c = replyCache.find(key); c != replyCache.end()) {
+        auto e = c->second;
+        if (now < e->expires) {
+            cachedReplies.splice(cachedReplies.begin(), cachedReplies, e);
+            return e->res;
+        }
+        replyCache.erase(c);
+        cachedReplies.erase(e);
+    }
+    auto res = pd.fn(args);
+    if (replyCache.size() >= maxCached) {
+        replyCache.erase(cachedReplies.back().key);
+        cachedReplies.pop_back();
+    }
+    cachedReplies.push_front({std::move(key), now + std::chrono::milliseconds(pd.maxAge), res});
+    replyCache.emplace(cachedReplies.front().key, cachedReplies.begin());
+    return res;
+}
+
+/*
+ * Replies of queued probes are published in batches, each costing sync one
+ * sync interest and one pass over pending peer interests. A batch goes out
+ * when the queue empties, when its first reply has waited maxBatchDelay or
+ * before a probe that isn't cheap runs (so a reply is never held up behind
+ * a slow probe).
+ */
+static constexpr auto maxBatchDelay = std::chrono::milliseconds(2);
+static std::vector<CRshim*> batchedShims;
+static size_t nBatched{};
+static std::chrono::steady_clock::time_point batchStart{};
+
+static void batched()
+{
+    if (nBatched++ == 0) {
+        batchStart = std::chrono::steady_clock::now();
+    }
+}
+
+static void batchReply(CRshim& shim, RName& r, std::string&& res)
+{
+    if (shim.queuedReplies() == 0) {
+        batchedShims.push_back(&shim);
+    }
+    shim.queueReply(r, std::move(res));
+    batched();
+}
+
+/*
+ * A traced reply is held until its batch is published so its 'publish'
+ * span, and the reply's timestamp, include the time it waited in the batch.
+ */
+struct HeldReply {
+    CRshim* shim;
+    RName r;
+    std::string res;
+    ReplyTrailer t;
+    CmdTrace tr;
+    TraceSpans ts;
+};
+static std::vector<HeldReply> heldReplies;
+
+static void holdReply(CRshim& shim, RName& r, std::string&& res, ReplyTrailer&& t,
+                      const CmdTrace& tr, const TraceSpans& ts)
+{
+    heldReplies.push_back({&shim, r, std::move(res), std::move(t), tr, ts});
+    batched();
+}
+
+static void flushReplies()
+{
+    for (auto& h : heldReplies) {
+        h.ts.publish = h.tr.us(CmdTrace::clock::now());
+        h.t[ReplyTrailer::trace] = h.ts.encode();
+        h.t.appendTo(h.res);
+        batchReply(*h.shim, h.r, std::move(h.res));
+    }
+    heldReplies.clear();
+    for (auto s : batchedShims) {
+        s->flushReplies();
+    }
+    batchedShims.clear();
+    nBatched = 0;
+}
+
+static int64_t wallUs(std::chrono::system_clock::time_point t = std::chrono::system_clock::now())
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(t.time_since_epoch()).count();
+}
+
+/*
+ * Run command 'r's probe and queue its reply. 'at' is the instant the
+ * command asked to be run at (0 if none). Such commands bypass the reply
+ * cache, since they want a sample taken then, and report when they ran.
+ */
+static void runCmd(RName& r, CRshim& shim, const ProbeDesc& pd,
+                   const std::optional<CmdTrace>& tr = std::nullopt, int64_t at = 0)
 {
     try {
-        shim.sendReply(r, probeTable.at(r.str("pType"))(r.str("pArgs")));
+        using clock = std::chrono::steady_clock;
+        if (pd.async()) {
+            pd.afn(r.str("pArgs"), ProbeCtx{r, shim, tr, clock::now(), at, at? wallUs() : 0});
+            return;
+        }
+        if (pd.cost != ProbeCost::cheap) {
+            // don't hold finished replies while a slow probe runs
+            flushReplies();
+        }
+        auto dispatch = clock::now();
+        auto ran = wallUs();
+        auto start = clock::now();
+        auto fetched = ndn::nfdManagementQ::fetchTime;
+        auto res = at? pd.fn(r.str("pArgs")) : runProbe(pd, r.str("pArgs"));
+        auto end = clock::now();
+        auto& ms = probeMs[pd.name];
+        ms += (std::chrono::duration<double, std::milli>(end - start).count() - ms) / 8;
+        probeLat.at(pd.name).observe(std::chrono::duration<double>(end - start).count());
+        ReplyTrailer t;
+        if (at) {
+            t[ReplyTrailer::at] = ReplyTrailer::encodeAt(at, ran);
+        }
+        if (tr) {
+            // (publish is stamped when the batch is flushed)
+            TraceSpans ts{tr->us(dispatch), tr->us(start),
+                          tr->us(ndn::nfdManagementQ::fetchTime - fetched), tr->us(end)};
+            holdReply(shim, r, std::move(res), std::move(t), *tr, ts);
+            return;
+        }
+        if (at) {
+            t.appendTo(res);
+        }
+        batchReply(shim, r, std::move(res));
     } catch (const std::exception& e) {
         std::cerr << e.what() << " for: " << r << std::endl;
     }
 }
 
+/*
+ * Deadline of a command: its 'dl' option if it has one, otherwise the
+ * probe's budget, both relative to the command's timestamp. Returns the
+ * time left (which is negative if the deadline has passed) or nullopt if
+ * there's no deadline.
+ */
+static std::optional<std::chrono::nanoseconds> timeLeft(const RName& r, const CmdOpts& o,
+                                                        const ProbeDesc& pd)
+{
+    auto dl = o.num("dl", pd.budget);
+    if (dl <= 0) {
+        return std::nullopt;
+    }
+    auto left = r["cTS"].toTimestamp() + ndn::time::milliseconds(dl)
+                    - ndn::time::system_clock::now();
+    return std::chrono::nanoseconds(ndn::time::duration_cast<ndn::time::nanoseconds>(left).count());
+}
+
+/*
+ * Run queued probes one per event loop pass so commands arriving
+ * meanwhile get to compete for the next slot.
+ */
+static void runQueued(CRshim& shim)
+{
+    sched.runOne();
+    updateDepths();
+    if (sched.empty() ||
+            (nBatched && std::chrono::steady_clock::now() - batchStart >= maxBatchDelay)) {
+        flushReplies();
+    }
+    if (! sched.empty()) {
+        schedTimer = shim.schedule(0_ms, [&shim] { runQueued(shim); });
+    }
+}
+
+/*
+ * Commands with an 'at' option are run at that wall clock instant rather
+ * than queued so a fan-out command samples every NOD at the same time (to
+ * within their clock sync). The timer goes off spinLead early and the rest
+ * is slept away (a sleep is more precise than an event loop wakeup and is
+ * never longer than spinLead, even if the wall clock steps meanwhile).
+ * Instants already past run now; ones more than maxAtLead ahead, or beyond
+ * maxAtPending waiting commands, are refused. Since these commands skip the
+ * scheduler only operators and users may give them.
+ */
+static constexpr auto spinLead = std::chrono::milliseconds(2);
+static constexpr auto maxAtLead = std::chrono::seconds(60);
+static constexpr size_t maxAtPending = 64;
+static std::map<uint64_t, Timer> atTimers;    // waiting commands' timers
+static uint64_t atSeq{};
+
+static void runAt(RName&& r, CRshim& shim, const ProbeDesc& pd, int64_t at,
+                  const std::optional<CmdTrace>& tr)
+{
+    using namespace std::chrono;
+    auto when = system_clock::time_point(microseconds(at));
+    auto lead = when - system_clock::now();
+    if (lead > maxAtLead || atTimers.size() >= maxAtPending) {
+        shim.sendReply(r, "probe " + r.str("pType") + " can't be run at requested time");
+        return;
+    }
+    auto id = atSeq++;
+    auto run = [r = std::move(r), &shim, &pd, at, tr, when, id]() mutable {
+        atTimers.erase(id);
+        auto left = when - system_clock::now();
+        if (left > left.zero()) {
+            std::this_thread::sleep_for(std::min<system_clock::duration>(left, spinLead));
+        }
+        runCmd(r, shim, pd, tr, at);
+        flushReplies();
+    };
+    if (lead <= spinLead) {
+        run();
+        return;
+    }
+    atTimers[id] = shim.schedule(
+            ndn::time::nanoseconds(duration_cast<nanoseconds>(lead - spinLead).count()),
+            std::move(run));
+}
+
+/*
+ * probeDispatch looks up the probe in probeTable and queues it to be run
+ * with the probe arguments.
+ * For asynchronous probes, need a way to callback to shim method to publish reply.
+ * This could require a different shim and different type of publication.
+ * Asynchronous probes can publish a reply with the location of their output.
+ */
+static void probeDispatch(RName&& r, CmdOpts&& o, CRshim& shim)
+{
+    std::optional<CmdTrace> tr;
+    if (o.num("tr")) {
+        tr.emplace();
+    }
+    const auto pd = probeTable.find(r.str("pType"));
+    if (pd == nullptr) {
+        std::cerr << "no probe for: " << r << std::endl;
+        return;
+    }
+    // no one will read the reply to a command that's already expired
+    auto left = timeLeft(r, o, *pd);
+    if (left && left->count() <= 0) {
+        bump(expired.late);
+        expired.savedMs += probeMs[pd->name];
+        return;
+    }
+    if (! pd->fanOut && r.str("tId") == "all") {
+        shim.sendReply(r, "probe " + r.str("pType") + " not allowed for target " + r.str("tId"));
+        return;
+    }
+    if (auto at = o.num("at"); at > 0) {
+        if (roleOf(r) == Role::guest) {
+            shim.sendReply(r, "probe " + r.str("pType") + " can't be run at requested time");
+            return;
+        }
+        runAt(std::move(r), shim, *pd, at, tr);
+        return;
+    }
+    if (sched.empty()) {
+        schedTimer = shim.schedule(0_ms, [&shim] { runQueued(shim); });
+    }
+    auto client = r.str("Id") + "/" + r.str("origin");
+    sched.push(roleOf(r), client, pd->cost,
+               [r = std::move(r), &shim, pd, tr]() mutable { runCmd(r, shim, *pd, tr); },
+               left? ProbeSched::clock::now() + *left : ProbeSched::clock::time_point::max(),
+               [pd] { bump(expired.queued); expired.savedMs += probeMs[pd->name]; });
+    updateDepths();
+}
+
+/*
+ * Export the NOD's sync, probe and queue metrics (and process memory use)
+ * on 'where' (a localhost port or unix socket path).
+ */
+static MetricsRegistry metrics;
+
+static void startMetrics(const std::string& where)
+{
+    for (const auto& [pfx, sp] : syncGroups) {
+        const auto& st = sp->stats();
+        auto l = "group=\"" + pfx + "\"";
+        metrics.counter("dnmp_sync_interests_sent_total", "sync interests sent", st.interestsSent, l)
+               .counter("dnmp_sync_interests_received_total", "sync interests received", st.interestsRcvd, l)
+               .counter("dnmp_sync_data_sent_total", "sync Data sent", st.dataSent, l)
+               .counter("dnmp_sync_data_received_total", "sync Data received", st.dataRcvd, l)
+               .counter("dnmp_sync_pubs_published_total", "local publications", st.pubsPublished, l)
+               .counter("dnmp_sync_pubs_received_total", "new publications from peers", st.pubsRcvd, l)
+               .counter("dnmp_sync_pubs_delivered_total", "publications delivered to subscribers", st.pubsDelivered, l)
+               .counter("dnmp_sync_pubs_known_total", "arriving publications skipped as already known", st.pubsKnown, l)
+               .counter("dnmp_sync_data_skipped_total", "sync Data not validated as all its pubs were known", st.dataSkipped, l)
+               .counter("dnmp_sync_decode_failures_total", "undecodable sync packets", st.decodeFails, l)
+               .counter("dnmp_sync_more_sent_total", "requests for more rateless iblt symbols sent", st.moreSent, l)
+               .counter("dnmp_sync_symbols_sent_total", "rateless iblt symbols sent", st.symbolsSent, l)
+               .counter("dnmp_sync_nacks_total", "sync interest nacks", st.nacks, l)
+               .counter("dnmp_sync_timeouts_total", "sync interest timeouts", st.timeouts, l)
+               .gauge("dnmp_sync_active_pubs", "publications in the active set", st.activePubs, l)
+               .gauge("dnmp_sync_pending_interests", "peer interests waiting for a reply", st.pendingInterests, l)
+               .gauge("dnmp_sync_subscriptions", "subscriptions", st.subscriptions, l);
+    }
+    for (const auto& [name, h] : probeLat) {
+        metrics.histogram("dnmp_probe_duration_seconds", "probe run time", h,
+                          "probe=\"" + std::string(name) + "\"");
+    }
+    for (size_t r = 0; r < queueDepth.size(); ++r) {
+        metrics.gauge("dnmp_queue_depth", "commands waiting to run", queueDepth[r],
+                      "role=\"" + std::string(roleName[r]) + "\"");
+    }
+    metrics.counter("dnmp_commands_expired_total", "commands dropped after their deadline",
+                    expired.late, "when=\"arrival\"")
+           .counter("dnmp_commands_expired_total", "commands dropped after their deadline",
+                    expired.queued, "when=\"queued\"")
+           .gauge("dnmp_process_resident_memory_bytes", "resident set size", [] {
+                long pages[2]{};
+                if (auto f = fopen("/proc/self/statm", "r"); f) {
+                    if (fscanf(f, "%ld %ld", &pages[0], &pages[1]) != 2) pages[1] = 0;
+                    fclose(f);
+                }
+                return double(pages[1]) * sysconf(_SC_PAGESIZE);
+            });
+    static MetricsServer server(metrics, where);
+}
+
 static struct option opts[] = {
+    {"operator", required_argument, nullptr, 'o'},
+    {"metrics", required_argument, nullptr, 'm'},
     {"debug", no_argument, nullptr, 'd'},
     {"help", no_argument, nullptr, 'h'}
 };
 
 static void usage(const char* cname)
 {
-    std::cerr << "usage: " << cname << " [--debug]\n";
+    std::cerr << "usage: " << cname
+              << " [--debug] [-o|--operator id]... [-m|--metrics port|path]\n";
 }
 
 /*
@@ -88,9 +1047,16 @@ static void usage(const char* cname)
 int main(int argc, char* argv[])
 {
     //initialization
+    std::string metricsAt;
     for (int c;
-         (c = getopt_long(argc, argv, "dh", opts, nullptr)) != -1;) {
+         (c = getopt_long(argc, argv, "o:m:dh", opts, nullptr)) != -1;) {
         switch (c) {
+        case 'o':
+            operators.emplace(optarg);
+            break;
+        case 'm':
+            metricsAt = optarg;
+            break;
         case 'd':
             ++debug;
             break;
@@ -104,9 +1070,24 @@ int main(int argc, char* argv[])
     // face so they'll share the same event hander).
 
     auto shims{CRshim::shims("local", "all", CRshim::myPID())};
-    for (auto& s : shims) s.waitForCmd(probeDispatch);
+    for (auto& s : shims) {
+        s.waitForCmd(probeDispatch);
+        syncGroups.emplace_back(s.prefix().toUri(), &s.pubsub());
+    }
+    // local clients can skip the forwarder (see local-link.hpp)
+    try {
+        shims[0].serveLocal();
+    } catch (const std::exception& e) {
+        std::cerr << "no local link: " << e.what() << std::endl;
+    }
+    boost::asio::signal_set sigs(shims[0].ioService(), SIGUSR1);
+    dumpOnSignal(sigs);
+    lagTick(shims[0]);
 
     try {
+        if (! metricsAt.empty()) {
+            startMetrics(metricsAt);
+        }
         shims[0].run();
     } catch (const std::exception& e) {
         std::cerr << e.what() << std::endl;
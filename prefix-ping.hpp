@@ -0,0 +1,226 @@
+#ifndef PREFIX_PING_HPP
+#define PREFIX_PING_HPP
+/*
+ * prefix-ping.hpp: rate-controlled NDN ping of a name prefix
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * PrefixPing sends Interests for <prefix>/ping/<n> (the ndnping convention,
+ * so an ndnpingserver or any producer of the prefix answers) at a fixed
+ * rate for a given time and summarizes the answers: RTTs, timeouts and
+ * Nacks.
+ *
+ * To hold kHz rates without a timer per Interest, a timer ticks at most
+ * once a ms and each tick sends however many Interests are due since the
+ * start (elapsed time * rate), so the rate is exact on average whatever the
+ * timer jitter. RTTs go in a log-scale histogram with 4 buckets per octave
+ * (about 19% wide) from 1us to ~67s.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/util/scheduler.hpp>
+
+class LogHist
+{
+  public:
+    static constexpr int perOctave = 4;
+    static constexpr size_t nBuckets = 26 * perOctave;
+
+    void add(double us)
+    {
+        auto i = us < 1.? 0 : std::min<size_t>(perOctave * std::log2(us), nBuckets - 1);
+        ++m_bucket[i];
+        ++m_n;
+    }
+    uint64_t count() const { return m_n; }
+
+    // 'p'th percentile (us): the geometric middle of the bucket it's in
+    double pct(double p) const
+    {
+        if (m_n == 0) {
+            return 0.;
+        }
+        uint64_t target = std::max<uint64_t>(std::ceil(p * m_n), 1), cum = 0;
+        for (size_t i = 0; i < nBuckets; ++i) {
+            if ((cum += m_bucket[i]) >= target) {
+                return std::exp2((i + .5) / perOctave);
+            }
+        }
+        return std::exp2(double(nBuckets) / perOctave);
+    }
+
+    // non-empty buckets as "lower_bound_us:count ..."
+    std::string str() const
+    {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(0);
+        const char* sep = "";
+        for (size_t i = 0; i < nBuckets; ++i) {
+            if (m_bucket[i]) {
+                s << sep << std::exp2(double(i) / perOctave) << ":" << m_bucket[i];
+                sep = " ";
+            }
+        }
+        return s.str();
+    }
+
+  private:
+    std::array<uint64_t, nBuckets> m_bucket{};
+    uint64_t m_n{};
+};
+
+class PrefixPing
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct Params {
+        double rate{10};                                // Interests/sec
+        std::chrono::milliseconds duration{5000};
+        std::chrono::milliseconds lifetime{1000};       // of each Interest
+    };
+
+    struct Result {
+        uint64_t sent{};
+        uint64_t rcvd{};
+        uint64_t timeouts{};
+        uint64_t nacks{};
+        double secs{};          // time taken to send
+        double minUs{};
+        double maxUs{};
+        double sumUs{};
+        LogHist rtt{};
+
+        std::string str() const
+        {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(3)
+              << "sent " << sent << " rcvd " << rcvd << " timeouts " << timeouts
+              << " nacks " << nacks << " loss(%) " << (sent? 100. * (sent - rcvd) / sent : 0.)
+              << "\nrate(Hz): " << (secs > 0? sent / secs : 0.)
+              << "\nrtt(ms): min " << minUs * 1e-3 << " avg " << (rcvd? sumUs * 1e-3 / rcvd : 0.)
+              << " p50 " << rtt.pct(.5) * 1e-3 << " p90 " << rtt.pct(.9) * 1e-3
+              << " p99 " << rtt.pct(.99) * 1e-3 << " max " << maxUs * 1e-3
+              << "\nrtt histogram(us): " << rtt.str() << "\n";
+            return s.str();
+        }
+    };
+    using Done = std::function<void(Result&&)>;
+
+    PrefixPing(ndn::Face& face, const ndn::Name& prefix, const Params& p, Done&& done)
+        : m_face{face}, m_sched{face.getIoService()},
+          m_prefix{ndn::Name(prefix).append("ping")}, m_p{p}, m_done{std::move(done)},
+          m_count(std::max<uint64_t>(p.rate * p.duration.count() / 1000., 1)),
+          m_tick{std::max(std::chrono::duration_cast<clock::duration>(std::chrono::milliseconds(1)),
+                          std::chrono::duration_cast<clock::duration>(
+                                std::chrono::duration<double>(1. / p.rate)))},
+          m_base{std::random_device{}()}
+    {}
+
+    void start()
+    {
+        m_start = clock::now();
+        tick();
+    }
+
+  private:
+    void tick()
+    {
+        auto now = clock::now();
+        auto due = std::min<uint64_t>(
+                        std::chrono::duration<double>(now - m_start).count() * m_p.rate + 1, m_count);
+        while (m_res.sent < due) {
+            send(m_res.sent++, now);
+        }
+        if (m_res.sent < m_count) {
+            m_timer = m_sched.schedule(ndn::time::nanoseconds(m_tick.count()), [this] { tick(); });
+        } else {
+            m_res.secs = std::chrono::duration<double>(now - m_start).count();
+        }
+    }
+
+    void send(uint64_t seq, clock::time_point now)
+    {
+        ndn::Interest i(ndn::Name(m_prefix).appendNumber(m_base + seq));
+        i.setCanBePrefix(false);
+        i.setMustBeFresh(true);
+        i.setInterestLifetime(ndn::time::milliseconds(m_p.lifetime.count()));
+        m_pending[seq] = now;
+        m_face.expressInterest(i,
+                [this, seq](auto&, auto&) { onData(seq); },
+                [this, seq](auto&, auto&) { ++m_res.nacks; done(seq); },
+                [this, seq](auto&) { ++m_res.timeouts; done(seq); });
+    }
+
+    void onData(uint64_t seq)
+    {
+        auto p = m_pending.find(seq);
+        if (p == m_pending.end()) {
+            return;
+        }
+        auto us = std::chrono::duration<double, std::micro>(clock::now() - p->second).count();
+        m_res.minUs = m_res.rcvd? std::min(m_res.minUs, us) : us;
+        m_res.maxUs = std::max(m_res.maxUs, us);
+        m_res.sumUs += us;
+        m_res.rtt.add(us);
+        ++m_res.rcvd;
+        done(seq);
+    }
+
+    void done(uint64_t seq)
+    {
+        m_pending.erase(seq);
+        if (m_res.sent < m_count || ! m_pending.empty() || ! m_done) {
+            return;
+        }
+        // the callback may destroy this object so it must be called last
+        auto d = std::move(m_done);
+        m_done = nullptr;
+        d(std::move(m_res));
+    }
+
+    ndn::Face& m_face;
+    ndn::Scheduler m_sched;
+    ndn::Name m_prefix;     // <prefix>/ping
+    Params m_p;
+    Done m_done;
+    uint64_t m_count;       // Interests to send
+    clock::duration m_tick;
+    uint64_t m_base;        // random start so names aren't reused across runs
+    Result m_res{};
+    std::unordered_map<uint64_t, clock::time_point> m_pending{};
+    clock::time_point m_start{};
+    ndn::scheduler::ScopedEventId m_timer{};
+};
+
+#endif // PREFIX_PING_HPP
@@ -0,0 +1,132 @@
+#ifndef PROBE_REGISTRY_HPP
+#define PROBE_REGISTRY_HPP
+/*
+ * probe-registry.hpp: DNMP probe descriptors and their dispatch table
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * Each probe a NOD offers is described by a ProbeDesc giving, in addition to
+ * the probe function, what the NOD needs to know to schedule, cache and admit
+ * commands for it. The descriptors are collected in a ProbeTable which is
+ * built at compile time with a perfect hash of the probe names, so looking up
+ * a command's probeType is one hash and one string compare.
+ */
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+using pb_f = std::string (*)(const std::string&);
+
+// Asynchronous probes get a context (defined by the NOD) that identifies the
+// command and is used to send the probe's output when it's done.
+struct ProbeCtx;
+using apb_f = void (*)(const std::string&, ProbeCtx&&);
+
+// relative cost of running a probe (lower runs first)
+enum class ProbeCost : uint8_t { cheap, moderate, expensive };
+
+struct ProbeDesc {
+    std::string_view name;  // DNMP probeType keyword
+    pb_f fn;                // the probe
+    ProbeCost cost;
+    uint32_t maxAge;        // ms a result can be reused for the same args (0 = don't cache)
+    uint32_t budget;        // ms after cTS a reply is still of use when the
+                            // command has no deadline (0 = no deadline)
+    bool fanOut;            // ok to run for multi-NOD targets (e.g., 'all')
+    apb_f afn{};            // the probe if it replies asynchronously (fn unused)
+
+    // probe's work continues after it returns
+    constexpr bool async() const { return afn != nullptr; }
+};
+
+/*
+ * Compile-time perfect hash table of ProbeDescs. The table has a power-of-2
+ * number of slots at least twice the number of probes and the constructor
+ * searches for an FNV-1a seed that puts every name in its own slot (the
+ * search is bounded, and failing it fails the build).
+ */
+template<size_t N>
+class ProbeTable
+{
+  public:
+    static constexpr size_t nSlots = [] {
+        size_t s = 1;
+        while (s < 2 * N) s <<= 1;
+        return s;
+    }();
+
+    constexpr ProbeTable(const std::array<ProbeDesc, N>& d) : m_desc{d}
+    {
+        for (uint32_t seed = 1; seed < 100000; ++seed) {
+            if (trySeed(seed)) {
+                m_seed = seed;
+                return;
+            }
+        }
+        throw "ProbeTable: no perfect hash seed found";
+    }
+
+    // descriptor for probe 'name' or nullptr if there's no such probe
+    constexpr const ProbeDesc* find(std::string_view name) const
+    {
+        auto i = m_slot[hash(name, m_seed) & (nSlots - 1)];
+        return i >= 0 && m_desc[i].name == name? &m_desc[i] : nullptr;
+    }
+
+    constexpr auto begin() const { return m_desc.begin(); }
+    constexpr auto end() const { return m_desc.end(); }
+    constexpr size_t size() const { return N; }
+
+  private:
+    static constexpr uint32_t hash(std::string_view s, uint32_t seed)
+    {
+        uint32_t h = 2166136261u ^ seed;
+        for (auto c : s) {
+            h = (h ^ uint8_t(c)) * 16777619u;
+        }
+        return h ^ (h >> 15);
+    }
+
+    constexpr bool trySeed(uint32_t seed)
+    {
+        for (auto& s : m_slot) s = -1;
+        for (size_t i = 0; i < N; ++i) {
+            auto& s = m_slot[hash(m_desc[i].name, seed) & (nSlots - 1)];
+            if (s >= 0) {
+                return false;
+            }
+            s = int16_t(i);
+        }
+        return true;
+    }
+
+    std::array<ProbeDesc, N> m_desc;
+    std::array<int16_t, nSlots> m_slot{};
+    uint32_t m_seed{};
+};
+
+template<size_t N>
+ProbeTable(const std::array<ProbeDesc, N>&) -> ProbeTable<N>;
+
+#endif // PROBE_REGISTRY_HPP
@@ -0,0 +1,220 @@
+#ifndef PROBE_SCHED_HPP
+#define PROBE_SCHED_HPP
+/*
+ * probe-sched.hpp: role-based scheduling of a NOD's pending probe work
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * Commands waiting to run are queued by the role of their issuer
+ * (operator, user or guest). The classes share the NOD with weighted
+ * round robin: each round a class may run up to its weight in commands
+ * so operators see low latency under contention but guests aren't
+ * starved. Within a class each client (issuer ID + origin) has its own
+ * queue and clients take turns so one client's burst can't monopolize
+ * its class. A client's cheapest pending probe runs first.
+ *
+ * Work can have a deadline after which its result is of no use (its issuer
+ * has stopped listening). Expired work is dropped without being run, and
+ * counted, when it comes up to run (so picking the next piece of work
+ * doesn't cost a pass over everything queued).
+ *
+ * Everything runs on the face thread so there's no locking.
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "probe-registry.hpp"
+
+enum class Role : uint8_t { op, user, guest };
+static constexpr std::array<const char*, 3> roleName{"operator", "user", "guest"};
+
+class ProbeSched
+{
+  public:
+    using Work = std::function<void()>;
+    using clock = std::chrono::steady_clock;
+
+    // round robin weights of operator, user, guest classes
+    explicit ProbeSched(std::array<uint32_t, 3> weights = {8, 3, 1})
+    {
+        for (size_t i = 0; i < m_class.size(); ++i) {
+            m_class[i].weight = m_class[i].credits = std::max(weights[i], 1u);
+        }
+    }
+
+    /*
+     * queue work 'w' for 'client'. If the work's 'deadline' passes before
+     * it gets to run, 'expire' (if any) is called instead.
+     */
+    void push(Role r, const std::string& client, ProbeCost cost, Work&& w,
+              clock::time_point deadline = clock::time_point::max(), Work&& expire = {})
+    {
+        auto& c = m_class[size_t(r)];
+        auto& q = c.clients[client];
+        if (q.empty()) {
+            c.rr.push_back(client);
+        }
+        q.push({std::move(w), std::move(expire), cost, clock::now(), deadline});
+        ++c.depth;
+        ++m_depth;
+    }
+
+    bool empty() const { return m_depth == 0; }
+    size_t depth() const { return m_depth; }
+    size_t depth(Role r) const { return m_class[size_t(r)].depth; }
+
+    /*
+     * Run the next piece of work that hasn't expired. Returns false if
+     * there was none.
+     */
+    bool runOne()
+    {
+        auto now = clock::now();
+        for (int ci; (ci = nextClass()) >= 0; ) {
+            auto& c = m_class[ci];
+            auto client = std::move(c.rr.front());
+            c.rr.pop_front();
+            auto& q = c.clients[client];
+            auto item = q.pop();
+            if (q.empty()) {
+                c.clients.erase(client);
+            } else {
+                c.rr.push_back(std::move(client));
+            }
+            --c.depth;
+            --m_depth;
+
+            if (item.deadline <= now) {
+                if (item.expire) {
+                    item.expire();
+                }
+                ++c.expired;
+                continue;
+            }
+            --c.credits;
+            c.wait.add(now - item.enq);
+            item.run();
+            return true;
+        }
+        return false;
+    }
+
+    // per-class queue depth and queueing latency
+    std::string stats() const
+    {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(3);
+        for (size_t i = 0; i < m_class.size(); ++i) {
+            const auto& c = m_class[i];
+            s << roleName[i] << ": weight " << c.weight << " depth " << c.depth
+              << " run " << c.wait.n << " wait(ms) avg " << c.wait.avg()
+              << " recent " << c.wait.ewma << " max " << c.wait.max
+              << " expired " << c.expired << "\n";
+        }
+        return s.str();
+    }
+
+  private:
+    struct Item {
+        Work run;
+        Work expire;
+        ProbeCost cost;
+        clock::time_point enq;
+        clock::time_point deadline;
+    };
+    struct WaitStats {
+        uint64_t n{};
+        double sum{};       // all in ms
+        double max{};
+        double ewma{};
+        void add(clock::duration d)
+        {
+            double ms = std::chrono::duration<double, std::milli>(d).count();
+            ++n;
+            sum += ms;
+            max = std::max(max, ms);
+            ewma = n == 1? ms : ewma + (ms - ewma) / 8;
+        }
+        double avg() const { return n? sum / n : 0.; }
+    };
+    // a client's work, FIFO within each cost so the cheapest is at a front
+    struct Queue {
+        std::array<std::deque<Item>, 3> byCost{};
+        size_t size{};
+
+        bool empty() const { return size == 0; }
+        void push(Item&& i)
+        {
+            byCost[size_t(i.cost)].push_back(std::move(i));
+            ++size;
+        }
+        Item pop()
+        {
+            auto& q = *std::find_if(byCost.begin(), byCost.end(),
+                                    [](const auto& q) { return ! q.empty(); });
+            auto i = std::move(q.front());
+            q.pop_front();
+            --size;
+            return i;
+        }
+    };
+    struct Class {
+        uint32_t weight{1};
+        uint32_t credits{1};
+        size_t depth{};
+        std::unordered_map<std::string, Queue> clients{};
+        std::deque<std::string> rr{};   // clients with work, in turn order
+        WaitStats wait{};
+        uint64_t expired{};             // work dropped after its deadline
+    };
+
+    // highest priority class with both work and credits left this round
+    int nextClass()
+    {
+        if (m_depth == 0) {
+            return -1;
+        }
+        for (int pass = 0; pass < 2; ++pass) {
+            for (size_t i = 0; i < m_class.size(); ++i) {
+                if (m_class[i].depth && m_class[i].credits) {
+                    return i;
+                }
+            }
+            // every class with work has used its share: start a new round
+            for (auto& c : m_class) c.credits = c.weight;
+        }
+        return -1;
+    }
+
+    std::array<Class, 3> m_class{};
+    size_t m_depth{};
+};
+
+#endif // PROBE_SCHED_HPP
@@ -44,7 +44,12 @@ static std::string echoProbe(const std::string& args) {
 #include <ndn-cxx/util/scheduler.hpp>
 #include <ndn-cxx/mgmt/nfd/forwarder-status.hpp>
 #include <ndn-cxx/mgmt/nfd/rib-entry.hpp>
+#include <ndn-cxx/encoding/block-helpers.hpp>
 #include <ndn-cxx/encoding/tlv-nfd.hpp>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
 
 
 /*
@@ -56,34 +61,74 @@ namespace ndn {
    class nfdManagementQ : noncopyable
    {
     public:
+    /*
+     * Probes normally reach the local NFD through a Face of their own. A test
+     * or benchmark harness can replace 'makeFace' (e.g., with FakeNfd::face)
+     * so probes run against a stand-in forwarder.
+     */
+    using FaceMaker = std::function<std::unique_ptr<Face>()>;
+    static inline FaceMaker makeFace = []{ return std::make_unique<Face>(); };
+
+    nfdManagementQ() : m_face(makeFace()) {}
+
     void run(std::string s)
     {
         Interest interest(Name(s.c_str()));
-        interest.setInterestLifetime(2_s); // 2 seconds
         interest.setCanBePrefix(true);
         interest.setMustBeFresh(true);
-
-        m_face.expressInterest(interest,
-                           bind(&nfdManagementQ::onData, this,  _1, _2),
-                           bind(&nfdManagementQ::onNack, this, _1, _2),
-                           bind(&nfdManagementQ::onTimeout, this, _1));
-
-        LOG("nfdManagementQ entity sending Interest:");
-        LOG(interest);
+        express(interest);
 
         // processEvents will block until the requested data received or timeout occurs
-        m_face.processEvents();
+        auto start = std::chrono::steady_clock::now();
+        m_face->processEvents();
+        fetchTime += std::chrono::steady_clock::now() - start;
     }
+    // running total of this thread's time waiting on NFD (used for tracing)
+    static inline thread_local std::chrono::steady_clock::duration fetchTime{};
+
+    // first (or only) segment of the dataset
     const Data& dataVal()
     {
         return mgmtData;
     }
+    // Content block reassembled from all the dataset's segments
+    Block content() const
+    {
+        return makeBinaryBlock(tlv::Content, m_content.data(), m_content.size());
+    }
+    size_t segments() const { return m_segs; }
+
     private:
+    void express(Interest& interest)
+    {
+        interest.setInterestLifetime(2_s); // 2 seconds
+        m_face->expressInterest(interest,
+                           bind(&nfdManagementQ::onData, this,  _1, _2),
+                           bind(&nfdManagementQ::onNack, this, _1, _2),
+                           bind(&nfdManagementQ::onTimeout, this, _1));
+
+        LOG("nfdManagementQ entity sending Interest:");
+        LOG(interest);
+    }
     void onData(const Interest& interest, const Data& data)
     {
       LOG("nfdManagementQ entity received Data: ");
       LOG(data);
-      mgmtData = data;
+      if (m_segs++ == 0) {
+          mgmtData = data;
+      }
+      const auto& c = data.getContent();
+      m_content.insert(m_content.end(), c.value_begin(), c.value_end());
+
+      // NFD segments large datasets as <dataset>/<version>/<segment>.
+      // Keep fetching until the final segment has arrived.
+      const auto& n = data.getName();
+      const auto& fb = data.getFinalBlock();
+      if (!n.empty() && n[-1].isSegment() && fb && *fb != n[-1]) {
+          Interest next(n.getPrefix(-1).appendSegment(n[-1].toSegment() + 1));
+          next.setMustBeFresh(true);
+          express(next);
+      }
     }
     void onNack(const Interest& interest, const lp::Nack& nack)
     {
@@ -97,8 +142,10 @@ namespace ndn {
         LOG("nfdManagmentQ entity received Timeout for Interest");
     }
     private:
-        Face m_face;
+        std::unique_ptr<Face> m_face;
         Data mgmtData;
+        std::vector<uint8_t> m_content;
+        size_t m_segs{};
    };
 } // namespace ndn
 
@@ -140,7 +187,7 @@ static std::string nfdGSProbe(const std::string& args) {
     ndn::nfd::ForwarderStatus status;
     try {
         fetcher.run(("/localhost/nfd/status/general"));
-        status = ndn::nfd::ForwarderStatus((fetcher.dataVal()).getContent());
+        status = ndn::nfd::ForwarderStatus(fetcher.content());
         LOG(status);
     }
     catch (const std::exception& e) {
@@ -199,7 +246,7 @@ static std::string nfdRIBProbe(const std::string& args) {
     try {
         fetcher.run(("/localhost/nfd/rib/list"));
         dataset = parseDatasetVector<ndn::nfd::RibEntry>
-            (std::move((fetcher.dataVal()).getContent()), ndn::tlv::nfd::RibEntry);
+            (fetcher.content(), ndn::tlv::nfd::RibEntry);
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -247,7 +294,7 @@ static std::string nfdStrategyProbe(const std::string& args) {
     try {
         fetcher.run(("/localhost/nfd/strategy-choice/list"));
         dataset = parseDatasetVector<ndn::nfd::StrategyChoice>
-            (std::move((fetcher.dataVal()).getContent()), ndn::tlv::nfd::StrategyChoice);
+            (fetcher.content(), ndn::tlv::nfd::StrategyChoice);
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -276,7 +323,7 @@ static std::string nfdFSProbe(const std::string& args) {
     try {
         fetcher.run(("/localhost/nfd/faces/list"));
         dataset = parseDatasetVector<ndn::nfd::FaceStatus>
-            (std::move((fetcher.dataVal()).getContent()), ndn::tlv::nfd::FaceStatus);
+            (fetcher.content(), ndn::tlv::nfd::FaceStatus);
     }
     catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
@@ -289,6 +336,61 @@ static std::string nfdFSProbe(const std::string& args) {
     return result.str();
 }
 
+/*
+ * nfdCsInfoProbe reads the Content Store info dataset (/localhost/nfd/cs/info).
+ * Besides NFD's cumulative counts it reports the hit and miss rates and the
+ * hit ratio since the previous sample (kept by the probe and shared by all
+ * its callers) so clients don't have to difference the counters themselves.
+ */
+
+#include <iomanip>
+#include <ndn-cxx/mgmt/nfd/cs-info.hpp>
+
+static std::string nfdCsInfoProbe(const std::string& args) {
+    static struct {
+        std::chrono::steady_clock::time_point when;
+        uint64_t hits;
+        uint64_t misses;
+        bool valid;
+    } prev{};
+
+    ndn::nfdManagementQ fetcher;
+    ndn::nfd::CsInfo info;
+    try {
+        fetcher.run(("/localhost/nfd/cs/info"));
+        auto c = fetcher.content();
+        c.parse();
+        info.wireDecode(c.get(ndn::tlv::nfd::CsInfo));
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return std::string("No NFD CS info");
+    }
+    auto now = std::chrono::steady_clock::now();
+    auto hits = info.getNHits();
+    auto misses = info.getNMisses();
+    auto ratio = [](uint64_t h, uint64_t m) { return h + m? double(h) / (h + m) : 0.; };
+
+    std::ostringstream result;
+    result << std::fixed << std::setprecision(4)
+           << "Capacity: " << info.getCapacity() << "\n"
+           << "Entries: " << info.getNEntries() << "\n"
+           << "Admit: " << info.getEnableAdmit() << " Serve: " << info.getEnableServe() << "\n"
+           << "Hits: " << hits << " Misses: " << misses
+           << " HitRatio: " << ratio(hits, misses) << "\n";
+    // counters going backwards means NFD restarted
+    if (prev.valid && hits >= prev.hits && misses >= prev.misses) {
+        auto dt = std::chrono::duration<double>(now - prev.when).count();
+        auto dh = hits - prev.hits;
+        auto dm = misses - prev.misses;
+        result << "Interval(s): " << dt << " Hits/s: " << (dt > 0? dh / dt : 0.)
+               << " Misses/s: " << (dt > 0? dm / dt : 0.)
+               << " HitRatio: " << ratio(dh, dm) << "\n";
+    }
+    prev = {now, hits, misses, true};
+    return result.str();
+}
+
 /*
  * Probe that uses reply to return location for on-going data.
  * This is really rough, just testing out whether this is possible.
@@ -330,3 +432,167 @@ static std::string periodicProbe(const std::string& args) {
 
 }
 
+
+/*
+ * Host counter probes read /proc/net/dev, /proc/net/snmp and /proc/stat
+ * (see procfs.hpp) so a NOD can sample them often at little cost. Their
+ * argument is an optional comma-separated selection:
+ *   HostNetDev  interface names (default all)
+ *   HostSnmp    protocols: Ip, Icmp, Tcp, Udp (default all)
+ *   HostStat    cpu (all cpus), cpus (each cpu), ctxt, intr, softirq, procs
+ *               (default all but cpus)
+ */
+
+#include <charconv>
+#include "procfs.hpp"
+
+static ProcFile netDevFile("/proc/net/dev", 16384);
+static ProcFile netSnmpFile("/proc/net/snmp", 8192);
+static ProcFile hostStatFile("/proc/stat", 16384);
+
+// true if 'item' is in comma-separated 'sel' (or 'sel' is empty)
+static bool selected(std::string_view sel, std::string_view item)
+{
+    if (sel.empty()) {
+        return true;
+    }
+    for (size_t b = 0; b <= sel.size(); ) {
+        auto e = std::min(sel.find(',', b), sel.size());
+        if (sel.substr(b, e - b) == item) {
+            return true;
+        }
+        b = e + 1;
+    }
+    return false;
+}
+
+static void putNum(std::string& s, uint64_t v)
+{
+    char b[24];
+    s.append(b, std::to_chars(b, b + sizeof(b), v).ptr);
+}
+
+static void putField(std::string& s, std::string_view name, uint64_t v)
+{
+    s += ' ';
+    s += name;
+    s += ' ';
+    putNum(s, v);
+}
+
+static std::string hostNetDevProbe(const std::string& args)
+{
+    std::string res;
+    res.reserve(2048);
+    NetDevStats::parse(netDevFile.read(), [&args, &res](const NetDevStats& d) {
+        if (! selected(args, d.name)) {
+            return;
+        }
+        res += d.name;
+        res += ": rx";
+        putField(res, "bytes", d.rxBytes);
+        putField(res, "packets", d.rxPackets);
+        putField(res, "errs", d.rxErrs);
+        putField(res, "drop", d.rxDrop);
+        putField(res, "fifo", d.rxFifo);
+        putField(res, "frame", d.rxFrame);
+        putField(res, "multicast", d.rxMulticast);
+        res += " tx";
+        putField(res, "bytes", d.txBytes);
+        putField(res, "packets", d.txPackets);
+        putField(res, "errs", d.txErrs);
+        putField(res, "drop", d.txDrop);
+        putField(res, "fifo", d.txFifo);
+        putField(res, "colls", d.txColls);
+        putField(res, "carrier", d.txCarrier);
+        res += '\n';
+    });
+    return res;
+}
+
+static std::string hostSnmpProbe(const std::string& args)
+{
+    SnmpStats st{};
+    st.parse(netSnmpFile.read());
+    std::string res;
+    res.reserve(1024);
+    std::string_view proto;
+    for (const auto& f : SnmpStats::fields) {
+        if (! selected(args, f.proto)) {
+            continue;
+        }
+        if (f.proto != proto) {
+            if (! proto.empty()) {
+                res += '\n';
+            }
+            proto = f.proto;
+            res += proto;
+            res += ':';
+        }
+        putField(res, f.name, st.*f.val);
+    }
+    if (! proto.empty()) {
+        res += '\n';
+    }
+    return res;
+}
+
+static void putCpu(std::string& s, std::string_view name, const CpuTimes& t)
+{
+    s += name;
+    s += ':';
+    putField(s, "user", t.user);
+    putField(s, "nice", t.nice);
+    putField(s, "system", t.system);
+    putField(s, "idle", t.idle);
+    putField(s, "iowait", t.iowait);
+    putField(s, "irq", t.irq);
+    putField(s, "softirq", t.softirq);
+    putField(s, "steal", t.steal);
+    s += '\n';
+}
+
+static std::string hostStatProbe(const std::string& args)
+{
+    static HostStat st;     // too big for the stack
+    st.parse(hostStatFile.read());
+    std::string_view sel = args;
+    if (sel.empty()) {
+        sel = "cpu,ctxt,intr,softirq,procs";
+    }
+    std::string res;
+    res.reserve(256 + (selected(sel, "cpus")? st.nCpus * 128 : 0));
+    if (selected(sel, "cpu")) {
+        putCpu(res, "cpu", st.total);
+    }
+    if (selected(sel, "cpus")) {
+        char name[8] = "cpu";
+        for (size_t i = 0; i < st.nCpus; ++i) {
+            putCpu(res, {name, size_t(std::to_chars(name + 3, name + sizeof(name), i).ptr - name)},
+                   st.cpu[i]);
+        }
+    }
+    if (selected(sel, "ctxt")) {
+        res += "ctxt: ";
+        putNum(res, st.ctxt);
+        res += '\n';
+    }
+    if (selected(sel, "intr")) {
+        res += "intr: ";
+        putNum(res, st.intr);
+        res += '\n';
+    }
+    if (selected(sel, "softirq")) {
+        res += "softirq: ";
+        putNum(res, st.softirqs);
+        res += '\n';
+    }
+    if (selected(sel, "procs")) {
+        res += "procs:";
+        putField(res, "forks", st.forks);
+        putField(res, "running", st.running);
+        putField(res, "blocked", st.blocked);
+        res += '\n';
+    }
+    return res;
+}
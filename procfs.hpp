@@ -0,0 +1,384 @@
+#ifndef PROCFS_HPP
+#define PROCFS_HPP
+/*
+ * procfs.hpp: low-overhead readers of /proc files for DNMP probes
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * Probes that sample /proc files can be run at high rates so the files are
+ * opened once (at startup) and each sample is a pread of the whole file at
+ * offset 0 into a buffer that's kept between samples.
+ * The parsers work on views into that buffer and don't allocate.
+ */
+
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <vector>
+
+class ProcFile
+{
+  public:
+    explicit ProcFile(const char* path, size_t bufSize = 4096)
+        : m_fd{::open(path, O_RDONLY | O_CLOEXEC)}, m_buf(bufSize) {}
+    ~ProcFile() { if (m_fd >= 0) ::close(m_fd); }
+    ProcFile(const ProcFile&) = delete;
+    ProcFile& operator=(const ProcFile&) = delete;
+
+    bool ok() const { return m_fd >= 0; }
+
+    /*
+     * Current contents of the file (empty if it can't be read). The view is
+     * good until the next read. The buffer grows (once) if the file doesn't
+     * fit so later samples are a single pread.
+     */
+    std::string_view read()
+    {
+        if (m_fd < 0) {
+            return {};
+        }
+        size_t n = 0;
+        for (;;) {
+            auto r = ::pread(m_fd, m_buf.data() + n, m_buf.size() - n, n);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                return {};
+            }
+            if (r == 0) {
+                break;
+            }
+            n += r;
+            if (n == m_buf.size()) {
+                m_buf.resize(n * 2);
+            }
+        }
+        return {m_buf.data(), n};
+    }
+
+  private:
+    int m_fd;
+    std::vector<char> m_buf;
+};
+
+/*
+ * Number of entries in a /proc directory (e.g., /proc/self/fd).
+ */
+class ProcDir
+{
+  public:
+    explicit ProcDir(const char* path)
+        : m_fd{::open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)}, m_buf(8192) {}
+    ~ProcDir() { if (m_fd >= 0) ::close(m_fd); }
+    ProcDir(const ProcDir&) = delete;
+    ProcDir& operator=(const ProcDir&) = delete;
+
+    // entries other than '.' and '..' (-1 if the directory can't be read)
+    long count()
+    {
+        if (m_fd < 0 || ::lseek(m_fd, 0, SEEK_SET) < 0) {
+            return -1;
+        }
+        long n = 0;
+        for (;;) {
+            auto r = ::syscall(SYS_getdents64, m_fd, m_buf.data(), m_buf.size());
+            if (r <= 0) {
+                return r < 0? -1 : n;
+            }
+            // linux_dirent64: ino(8) off(8) reclen(2) type(1) name
+            for (long off = 0; off < r; ) {
+                auto d = m_buf.data() + off;
+                auto name = d + 19;
+                if (! (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0)))) {
+                    ++n;
+                }
+                off += *(const uint16_t*)(d + 16);
+            }
+        }
+    }
+
+  private:
+    int m_fd;
+    std::vector<char> m_buf;
+};
+
+/*
+ * Line/field scanner over the contents of a /proc file.
+ */
+struct ProcScan {
+    std::string_view s;
+
+    bool done() const { return s.empty(); }
+
+    // next blank-separated field on the current line (empty at end of line)
+    std::string_view word()
+    {
+        size_t b = 0;
+        while (b < s.size() && (s[b] == ' ' || s[b] == '\t')) ++b;
+        size_t e = b;
+        while (e < s.size() && s[e] != ' ' && s[e] != '\t' && s[e] != '\n') ++e;
+        auto w = s.substr(b, e - b);
+        s.remove_prefix(e);
+        return w;
+    }
+
+    // next field as an unsigned number (0 if it isn't one)
+    uint64_t num()
+    {
+        uint64_t v = 0;
+        for (auto c : word()) {
+            if (c < '0' || c > '9') break;
+            v = v * 10 + (c - '0');
+        }
+        return v;
+    }
+
+    void skip(size_t nFields) { while (nFields--) word(); }
+
+    // move to the start of the next line
+    void nextLine()
+    {
+        auto e = s.find('\n');
+        s.remove_prefix(e == s.npos? s.size() : e + 1);
+    }
+
+    // the rest of the current line (and move to the next)
+    std::string_view line()
+    {
+        auto e = s.find('\n');
+        auto l = s.substr(0, e);
+        nextLine();
+        return l;
+    }
+};
+
+/*
+ * This process's CPU use and size from /proc/self/stat
+ */
+struct SelfStat {
+    uint64_t utime;     // clock ticks
+    uint64_t stime;     // clock ticks
+    uint64_t threads;
+    uint64_t vsize;     // bytes
+    uint64_t rss;       // pages
+
+    // false if 's' isn't a stat file
+    bool parse(std::string_view s)
+    {
+        // the command name (field 2) can contain blanks so start after it
+        auto p = s.rfind(')');
+        if (p == s.npos) {
+            return false;
+        }
+        ProcScan sc{s.substr(p + 1)};
+        sc.skip(11);        // state .. cmajflt (fields 3-13)
+        utime = sc.num();
+        stime = sc.num();
+        sc.skip(4);         // cutime .. nice
+        threads = sc.num();
+        sc.skip(2);         // itrealvalue, starttime
+        vsize = sc.num();
+        rss = sc.num();
+        return true;
+    }
+};
+
+/*
+ * Per-interface counters from /proc/net/dev. 'name' is a view into the
+ * file's buffer (good until it's next read).
+ */
+struct NetDevStats {
+    std::string_view name;
+    uint64_t rxBytes, rxPackets, rxErrs, rxDrop, rxFifo, rxFrame, rxCompressed, rxMulticast;
+    uint64_t txBytes, txPackets, txErrs, txDrop, txFifo, txColls, txCarrier, txCompressed;
+
+    // call 'fn' with the stats of each interface in /proc/net/dev contents 's'
+    template<typename F>
+    static void parse(std::string_view s, F&& fn)
+    {
+        ProcScan sc{s};
+        sc.nextLine();      // two header lines
+        sc.nextLine();
+        while (! sc.done()) {
+            auto l = sc.line();
+            auto c = l.find(':');
+            if (c == l.npos) {
+                continue;
+            }
+            NetDevStats d{};
+            d.name = l.substr(0, c);
+            d.name.remove_prefix(std::min(d.name.find_first_not_of(' '), d.name.size()));
+            ProcScan f{l.substr(c + 1)};
+            for (auto v : {&NetDevStats::rxBytes, &NetDevStats::rxPackets, &NetDevStats::rxErrs,
+                           &NetDevStats::rxDrop, &NetDevStats::rxFifo, &NetDevStats::rxFrame,
+                           &NetDevStats::rxCompressed, &NetDevStats::rxMulticast,
+                           &NetDevStats::txBytes, &NetDevStats::txPackets, &NetDevStats::txErrs,
+                           &NetDevStats::txDrop, &NetDevStats::txFifo, &NetDevStats::txColls,
+                           &NetDevStats::txCarrier, &NetDevStats::txCompressed}) {
+                d.*v = f.num();
+            }
+            fn(d);
+        }
+    }
+};
+
+/*
+ * IP, ICMP, TCP and UDP counters from /proc/net/snmp. The file has a pair of
+ * lines for each protocol, one with the counter names and the next with their
+ * values. The counters kept (and their names) are listed in 'fields'.
+ */
+struct SnmpStats {
+    uint64_t ipInReceives, ipInHdrErrors, ipInAddrErrors, ipForwDatagrams, ipInDiscards,
+             ipInDelivers, ipOutRequests, ipOutDiscards, ipOutNoRoutes;
+    uint64_t icmpInMsgs, icmpInErrors, icmpOutMsgs, icmpOutErrors;
+    uint64_t tcpActiveOpens, tcpPassiveOpens, tcpAttemptFails, tcpEstabResets, tcpCurrEstab,
+             tcpInSegs, tcpOutSegs, tcpRetransSegs, tcpInErrs, tcpOutRsts;
+    uint64_t udpInDatagrams, udpNoPorts, udpInErrors, udpOutDatagrams, udpRcvbufErrors,
+             udpSndbufErrors;
+
+    struct Field {
+        std::string_view proto;
+        std::string_view name;
+        uint64_t SnmpStats::* val;
+    };
+    static constexpr Field fields[] = {
+        {"Ip", "InReceives", &SnmpStats::ipInReceives},
+        {"Ip", "InHdrErrors", &SnmpStats::ipInHdrErrors},
+        {"Ip", "InAddrErrors", &SnmpStats::ipInAddrErrors},
+        {"Ip", "ForwDatagrams", &SnmpStats::ipForwDatagrams},
+        {"Ip", "InDiscards", &SnmpStats::ipInDiscards},
+        {"Ip", "InDelivers", &SnmpStats::ipInDelivers},
+        {"Ip", "OutRequests", &SnmpStats::ipOutRequests},
+        {"Ip", "OutDiscards", &SnmpStats::ipOutDiscards},
+        {"Ip", "OutNoRoutes", &SnmpStats::ipOutNoRoutes},
+        {"Icmp", "InMsgs", &SnmpStats::icmpInMsgs},
+        {"Icmp", "InErrors", &SnmpStats::icmpInErrors},
+        {"Icmp", "OutMsgs", &SnmpStats::icmpOutMsgs},
+        {"Icmp", "OutErrors", &SnmpStats::icmpOutErrors},
+        {"Tcp", "ActiveOpens", &SnmpStats::tcpActiveOpens},
+        {"Tcp", "PassiveOpens", &SnmpStats::tcpPassiveOpens},
+        {"Tcp", "AttemptFails", &SnmpStats::tcpAttemptFails},
+        {"Tcp", "EstabResets", &SnmpStats::tcpEstabResets},
+        {"Tcp", "CurrEstab", &SnmpStats::tcpCurrEstab},
+        {"Tcp", "InSegs", &SnmpStats::tcpInSegs},
+        {"Tcp", "OutSegs", &SnmpStats::tcpOutSegs},
+        {"Tcp", "RetransSegs", &SnmpStats::tcpRetransSegs},
+        {"Tcp", "InErrs", &SnmpStats::tcpInErrs},
+        {"Tcp", "OutRsts", &SnmpStats::tcpOutRsts},
+        {"Udp", "InDatagrams", &SnmpStats::udpInDatagrams},
+        {"Udp", "NoPorts", &SnmpStats::udpNoPorts},
+        {"Udp", "InErrors", &SnmpStats::udpInErrors},
+        {"Udp", "OutDatagrams", &SnmpStats::udpOutDatagrams},
+        {"Udp", "RcvbufErrors", &SnmpStats::udpRcvbufErrors},
+        {"Udp", "SndbufErrors", &SnmpStats::udpSndbufErrors},
+    };
+
+    void parse(std::string_view s)
+    {
+        ProcScan sc{s};
+        while (! sc.done()) {
+            ProcScan names{sc.line()};
+            ProcScan vals{sc.line()};
+            auto proto = names.word();
+            if (proto.empty() || vals.word() != proto) {
+                continue;
+            }
+            proto.remove_suffix(1);     // the ':'
+            for (auto n = names.word(); ! n.empty(); n = names.word()) {
+                auto v = vals.num();
+                for (const auto& f : fields) {
+                    if (f.proto == proto && f.name == n) {
+                        this->*f.val = v;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+};
+
+/*
+ * CPU times (in clock ticks) and system activity counters from /proc/stat
+ */
+struct CpuTimes {
+    uint64_t user, nice, system, idle, iowait, irq, softirq, steal;
+};
+
+struct HostStat {
+    static constexpr size_t maxCpus = 256;
+
+    CpuTimes total;
+    std::array<CpuTimes, maxCpus> cpu;
+    size_t nCpus;
+    uint64_t ctxt;          // context switches
+    uint64_t intr;          // interrupts
+    uint64_t softirqs;
+    uint64_t forks;
+    uint64_t running;       // runnable tasks
+    uint64_t blocked;       // tasks blocked on I/O
+
+    void parse(std::string_view s)
+    {
+        nCpus = 0;
+        ProcScan sc{s};
+        while (! sc.done()) {
+            ProcScan l{sc.line()};
+            auto k = l.word();
+            if (k.compare(0, 3, "cpu") == 0) {
+                CpuTimes* t = &total;
+                if (k.size() > 3) {
+                    size_t n = 0;
+                    for (auto c : k.substr(3)) n = n * 10 + (c - '0');
+                    if (n >= maxCpus) {
+                        continue;
+                    }
+                    t = &cpu[n];
+                    nCpus = std::max(nCpus, n + 1);
+                }
+                for (auto v : {&CpuTimes::user, &CpuTimes::nice, &CpuTimes::system,
+                               &CpuTimes::idle, &CpuTimes::iowait, &CpuTimes::irq,
+                               &CpuTimes::softirq, &CpuTimes::steal}) {
+                    t->*v = l.num();
+                }
+            } else if (k == "ctxt") {
+                ctxt = l.num();
+            } else if (k == "intr") {
+                intr = l.num();
+            } else if (k == "softirq") {
+                softirqs = l.num();
+            } else if (k == "processes") {
+                forks = l.num();
+            } else if (k == "procs_running") {
+                running = l.num();
+            } else if (k == "procs_blocked") {
+                blocked = l.num();
+            }
+        }
+    }
+};
+
+#endif // PROCFS_HPP
@@ -81,13 +81,13 @@ static inline uint32_t ROTL32(uint32_t x, int8_t r)
 }
 
 static inline uint32_t murmurHash3(uint32_t nHashSeed,
-                     const std::vector<unsigned char>& vDataToHash)
+                     const uint8_t* data, size_t len)
 {
     uint32_t h1 = nHashSeed;
     const uint32_t c1 = 0xcc9e2d51;
     const uint32_t c2 = 0x1b873593;
-    const size_t nblocks = vDataToHash.size() / 4;
-    const uint32_t* blocks = (const uint32_t*)(&vDataToHash[0] + nblocks * 4);
+    const size_t nblocks = len / 4;
+    const uint32_t* blocks = (const uint32_t*)(data + nblocks * 4);
 
     for (size_t i = -nblocks; i; i++) {
         uint32_t k1 = blocks[i];
@@ -101,9 +101,9 @@ static inline uint32_t murmurHash3(uint32_t nHashSeed,
         h1 = h1 * 5 + 0xe6546b64;
     }
 
-    const uint8_t* tail = (const uint8_t*)(&vDataToHash[0] + nblocks * 4);
+    const uint8_t* tail = (const uint8_t*)(data + nblocks * 4);
     uint32_t k1 = 0;
-    switch (vDataToHash.size() & 3) {
+    switch (len & 3) {
     case 3:
         k1 ^= tail[2] << 16;
         NDN_CXX_FALLTHROUGH;
@@ -117,7 +117,7 @@ static inline uint32_t murmurHash3(uint32_t nHashSeed,
         k1 *= c2;
         h1 ^= k1;
     }
-    h1 ^= vDataToHash.size();
+    h1 ^= len;
     h1 ^= h1 >> 16;
     h1 *= 0x85ebca6b;
     h1 ^= h1 >> 13;
@@ -126,17 +126,20 @@ static inline uint32_t murmurHash3(uint32_t nHashSeed,
     return h1;
 }
 
+static inline uint32_t murmurHash3(uint32_t nHashSeed,
+                     const std::vector<unsigned char>& vDataToHash)
+{
+    return murmurHash3(nHashSeed, vDataToHash.data(), vDataToHash.size());
+}
+
 static inline uint32_t murmurHash3(uint32_t nHashSeed, const std::string& str)
 {
-    return murmurHash3(nHashSeed,
-                       std::vector<unsigned char>(str.begin(), str.end()));
+    return murmurHash3(nHashSeed, (const uint8_t*)str.data(), str.size());
 }
 
 static inline uint32_t murmurHash3(uint32_t nHashSeed, uint32_t value)
 {
-    return murmurHash3(nHashSeed,
-        std::vector<unsigned char>((unsigned char*)&value,
-                                   (unsigned char*)&value + sizeof(uint32_t)));
+    return murmurHash3(nHashSeed, (const uint8_t*)&value, sizeof(uint32_t));
 }
 
 class HashTableEntry
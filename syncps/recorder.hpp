@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2019,  Pollere Inc.
+ *
+ * This file is part of syncps (NDN sync for pubsub).
+ * See AUTHORS.md for complete list of syncps authors and contributors.
+ *
+ * syncps is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * syncps is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * syncps, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SYNCPS_RECORDER_HPP
+#define SYNCPS_RECORDER_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace syncps
+{
+
+/**
+ * @brief sync event types recorded by the flight recorder
+ */
+enum class SyncEv : uint8_t {
+    interestSent,   // hash: our iblt, a: active pubs
+    interestRcvd,   // hash: peer's iblt
+    interestPeeled, // hash: peer's iblt, a: have, b: need
+    dataSent,       // hash: peer's iblt, a: pubs sent
+    dataRcvd,       // hash: our iblt, a: pubs in Data, b: new pubs
+    pubAdded,       // hash: pub, a: 1 if local
+    pubExpired,     // hash: pub
+    decodeFail,     // hash: peer's iblt or Data name, a: reason (see below)
+    nack,           // hash: our iblt
+    timeout,        // hash: our iblt
+};
+enum : uint16_t { failIBLT = 1, failContentType = 2, failPubType = 3, failValidate = 4 };
+
+/**
+ * @brief Flight recorder: an always-on ring of the most recent sync events
+ *
+ * Each event is 16 bytes recorded with a couple of stores, so the recorder
+ * can be left on to support post-mortems of misbehaving sync groups.
+ * There is a single writer (the face thread) and no locks. Readers
+ * (e.g., a signal handler or another thread) take a snapshot and discard
+ * any entries that were overwritten while they were copying them.
+ */
+class FlightRecorder
+{
+  public:
+    static constexpr size_t size = 4096;    // must be a power of 2
+
+    struct Event {
+        uint64_t tsType;    // steady clock ns (low 56 bits) and event type (high 8)
+        uint32_t hash;
+        uint16_t a;
+        uint16_t b;
+
+        SyncEv type() const { return SyncEv(tsType >> 56); }
+        uint64_t ns() const { return tsType & ((1ULL << 56) - 1); }
+    };
+    static_assert(sizeof(Event) == 16);
+
+    void record(SyncEv t, uint32_t hash, size_t a = 0, size_t b = 0) noexcept
+    {
+        auto h = m_head.load(std::memory_order_relaxed);
+        m_ring[h & (size - 1)] = {(now() & ((1ULL << 56) - 1)) | uint64_t(t) << 56,
+                                  hash, sat(a), sat(b)};
+        m_head.store(h + 1, std::memory_order_release);
+    }
+
+    uint64_t recorded() const noexcept { return m_head.load(std::memory_order_acquire); }
+
+    /**
+     * @brief copy of (up to) the 'n' most recent events, oldest first
+     */
+    std::vector<Event> snapshot(size_t n = size) const
+    {
+        auto h = m_head.load(std::memory_order_acquire);
+        n = std::min({n, size, size_t(h)});
+        std::vector<Event> ev(n);
+        for (size_t i = 0; i < n; ++i) {
+            ev[i] = m_ring[(h - n + i) & (size - 1)];
+        }
+        // anything the writer lapped while we copied is garbage
+        auto lapped = m_head.load(std::memory_order_acquire) - h;
+        ev.erase(ev.begin(), ev.begin() + std::min<size_t>(lapped, ev.size()));
+        return ev;
+    }
+
+    /**
+     * @brief text dump of (up to) the 'n' most recent events.
+     *
+     * Times are ms before the dump.
+     */
+    std::string dump(size_t n = size) const
+    {
+        static constexpr const char* name[] = {
+            "intSent", "intRcvd", "peeled", "dataSent", "dataRcvd",
+            "pubAdded", "pubExpired", "decodeFail", "nack", "timeout"
+        };
+        auto ev = snapshot(n);
+        auto t = now();
+        std::ostringstream s;
+        s << ev.size() << " of " << recorded() << " sync events\n";
+        for (const auto& e : ev) {
+            s << std::dec << std::fixed << std::setprecision(3) << std::setw(11)
+              << (int64_t(t) - int64_t(e.ns())) * 1e-6 << " "
+              << std::setw(10) << std::left << name[size_t(e.type())] << std::right
+              << std::hex << std::setw(9) << e.hash << std::dec
+              << std::setw(6) << e.a << std::setw(6) << e.b << "\n";
+        }
+        return s.str();
+    }
+
+  private:
+    static uint64_t now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static uint16_t sat(size_t v) noexcept { return v > 0xffff? 0xffff : v; }
+
+    std::array<Event, size> m_ring{};
+    std::atomic<uint64_t> m_head{0};
+};
+
+}  // namespace syncps
+
+#endif  // SYNCPS_RECORDER_HPP
@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2019,  Pollere Inc.
+ *
+ * This file is part of syncps (NDN sync for pubsub).
+ * See AUTHORS.md for complete list of syncps authors and contributors.
+ *
+ * syncps is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * syncps is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR
+ * A PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * syncps, e.g., in COPYING.md file.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SYNCPS_RIBLT_HPP
+#define SYNCPS_RIBLT_HPP
+
+/*
+ * Rateless IBLT (after Yang, Gilad & Alizadeh, "Practical Rateless Set
+ * Reconciliation", SIGCOMM 2024).
+ *
+ * An IBLT has to be sized in advance for the set difference it will be
+ * asked to decode. A rateless IBLT is instead an unending sequence of coded
+ * symbols, each the (count, key xor, check xor) of some of the set's keys,
+ * like an IBLT cell. Every key is in symbol 0 and then in symbols at
+ * pseudo-random, increasingly sparse indices derived from the key (about
+ * 1/(1 + i/2) of the keys are in symbol i) so any prefix of the sequence can
+ * be made incrementally and the difference of two sets' prefixes peels just
+ * like the difference of two IBLTs. A difference of d keys decodes from
+ * about 1.35d symbols (proportionally more for small d), so a peer sends
+ * symbols until the other side says it has decoded.
+ */
+
+#include <cmath>
+#include <cstdint>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+#include <ndn-cxx/name.hpp>
+
+#include "syncps/iblt.hpp"
+
+namespace syncps {
+namespace riblt {
+
+struct Symbol {
+    int32_t count{};
+    uint32_t keySum{};
+    uint32_t keyCheck{};
+
+    static uint32_t check(uint32_t key) { return murmurHash3(N_HASHCHECK, key); }
+
+    void apply(uint32_t key, uint32_t chk, int dir) noexcept
+    {
+        count += dir;
+        keySum ^= key;
+        keyCheck ^= chk;
+    }
+    bool isPure() const { return (count == 1 || count == -1) && keyCheck == check(keySum); }
+    bool isEmpty() const noexcept { return count == 0 && keySum == 0 && keyCheck == 0; }
+};
+
+/*
+ * The indices of the symbols a key is in, in increasing order.
+ */
+class Mapping
+{
+  public:
+    explicit Mapping(uint32_t key) noexcept : m_prng{seed(key)} {}
+
+    uint64_t index() const noexcept { return m_idx; }
+
+    uint64_t next() noexcept
+    {
+        m_prng *= 0xda942042e4dd58b5ULL;
+        double step = std::ceil((double(m_idx) + 1.5) *
+                                (4294967296. / std::sqrt(double(m_prng) + 1.) - 1.));
+        // (indices past 'never' are never reached)
+        m_idx = step >= double(never - m_idx)? never : m_idx + uint64_t(step);
+        return m_idx;
+    }
+
+  private:
+    static constexpr uint64_t never = uint64_t(1) << 62;
+
+    // splitmix64 of the key (odd so the multiplicative prng never sticks at 0)
+    static uint64_t seed(uint32_t key) noexcept
+    {
+        uint64_t z = key + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return (z ^ (z >> 31)) | 1;
+    }
+
+    uint64_t m_prng;
+    uint64_t m_idx{};
+};
+
+/*
+ * Makes a set's symbols in order, a batch at a time. Copying an Encoder
+ * snapshots the set so later batches continue the same sequence.
+ */
+class Encoder
+{
+  public:
+    void add(uint32_t key) { add(key, Mapping(key)); }
+
+    // add a key whose symbols before 'm.index()' aren't to be made
+    void add(uint32_t key, const Mapping& m)
+    {
+        m_heap.push({m.index(), uint32_t(m_keys.size())});
+        m_keys.push_back({key, Symbol::check(key), m});
+    }
+
+    // the next 'n' symbols
+    std::vector<Symbol> next(size_t n)
+    {
+        std::vector<Symbol> s(n);
+        apply(s.data(), n, 1);
+        return s;
+    }
+
+    // add (dir 1) or subtract (dir -1) the set's next 'n' symbols to 's'
+    void apply(Symbol* s, size_t n, int dir)
+    {
+        auto end = m_next + n;
+        while (! m_heap.empty() && m_heap.top().first < end) {
+            auto [idx, k] = m_heap.top();
+            m_heap.pop();
+            auto& e = m_keys[k];
+            s[idx - m_next].apply(e.key, e.check, dir);
+            m_heap.push({e.map.next(), k});
+        }
+        m_next = end;
+    }
+
+    size_t produced() const noexcept { return m_next; }
+    size_t size() const noexcept { return m_keys.size(); }
+
+  private:
+    struct Key {
+        uint32_t key;
+        uint32_t check;
+        Mapping map;
+    };
+    using Next = std::pair<uint64_t, uint32_t>;     // (next symbol, key)
+
+    std::vector<Key> m_keys{};
+    std::priority_queue<Next, std::vector<Next>, std::greater<Next>> m_heap{};
+    uint64_t m_next{};
+};
+
+/*
+ * Decodes the difference between a peer's set, given as successive batches
+ * of its symbols, and our set (the Encoder it's constructed with). Keys
+ * only the peer has are 'theirs' and ones only we have are 'ours'. Both
+ * grow as symbols are added and the difference is completely decoded once
+ * every symbol so far has peeled to empty.
+ */
+class Decoder
+{
+  public:
+    explicit Decoder(Encoder&& ours) : m_set{std::move(ours)} {}
+
+    // add the peer's next symbols (they continue from the 'size()'th)
+    void add(const std::vector<Symbol>& peer)
+    {
+        auto base = m_cs.size();
+        m_cs.insert(m_cs.end(), peer.begin(), peer.end());
+        auto s = m_cs.data() + base;
+        auto n = peer.size();
+        m_set.apply(s, n, -1);
+        m_theirEnc.apply(s, n, -1);
+        m_ourEnc.apply(s, n, 1);
+        for (auto i = base; i < m_cs.size(); ++i) {
+            if (m_cs[i].isPure() || m_cs[i].isEmpty()) {
+                m_decodable.push_back(i);
+            }
+        }
+    }
+
+    // peel what the symbols so far allow. Returns true if the difference
+    // has been completely decoded.
+    bool decode()
+    {
+        for (size_t d = 0; d < m_decodable.size(); ++d) {
+            const auto c = m_cs[m_decodable[d]];
+            if (c.count == 0) {
+                ++m_resolved;
+            } else if (c.count == 1) {
+                m_theirEnc.add(c.keySum, peel(c.keySum, -1));
+                m_theirs.push_back(c.keySum);
+                ++m_resolved;
+            } else if (c.count == -1) {
+                m_ourEnc.add(c.keySum, peel(c.keySum, 1));
+                m_ours.push_back(c.keySum);
+                ++m_resolved;
+            }
+            // (a pure symbol can't become impure unless a check collided)
+        }
+        m_decodable.clear();
+        return decoded();
+    }
+
+    bool decoded() const noexcept { return m_resolved == m_cs.size(); }
+    size_t size() const noexcept { return m_cs.size(); }
+    const std::vector<uint32_t>& ours() const noexcept { return m_ours; }
+    const std::vector<uint32_t>& theirs() const noexcept { return m_theirs; }
+
+  private:
+    // take 'key' out of the symbols so far. Returns its mapping positioned
+    // at the first symbol not yet received.
+    Mapping peel(uint32_t key, int dir)
+    {
+        auto chk = Symbol::check(key);
+        Mapping m(key);
+        for (; m.index() < m_cs.size(); m.next()) {
+            auto& s = m_cs[m.index()];
+            s.apply(key, chk, dir);
+            if (s.isPure()) {
+                m_decodable.push_back(m.index());
+            }
+        }
+        return m;
+    }
+
+    Encoder m_set;                  // our set
+    Encoder m_theirEnc{};           // decoded keys only the peer has
+    Encoder m_ourEnc{};             // decoded keys only we have
+    std::vector<Symbol> m_cs{};     // peer's symbols less ours
+    std::vector<size_t> m_decodable{};
+    size_t m_resolved{};
+    std::vector<uint32_t> m_ours{};
+    std::vector<uint32_t> m_theirs{};
+};
+
+/*
+ * Symbols go in a name component as 12 bytes each, little-endian count,
+ * keySum and keyCheck (an IBLT's encoding without the compression since
+ * symbols are rarely empty).
+ */
+inline void appendToName(ndn::Name& name, const std::vector<Symbol>& syms)
+{
+    std::vector<uint8_t> b(syms.size() * 12);
+    auto put = [&b](size_t off, uint32_t v) {
+        for (int i = 0; i < 4; ++i) {
+            b[off + i] = uint8_t(v >> (8 * i));
+        }
+    };
+    for (size_t i = 0; i < syms.size(); ++i) {
+        put(i * 12, uint32_t(syms[i].count));
+        put(i * 12 + 4, syms[i].keySum);
+        put(i * 12 + 8, syms[i].keyCheck);
+    }
+    name.append(b.data(), b.size());
+}
+
+// throws std::runtime_error if 'c' isn't a whole number of symbols
+inline std::vector<Symbol> fromComponent(const ndn::name::Component& c)
+{
+    if (c.value_size() == 0 || c.value_size() % 12 != 0) {
+        throw std::runtime_error("rateless iblt component isn't a whole number of symbols");
+    }
+    auto b = c.value();
+    auto get = [b](size_t off) {
+        return uint32_t(b[off]) | uint32_t(b[off + 1]) << 8 | uint32_t(b[off + 2]) << 16 |
+               uint32_t(b[off + 3]) << 24;
+    };
+    std::vector<Symbol> syms(c.value_size() / 12);
+    for (size_t i = 0; i < syms.size(); ++i) {
+        syms[i] = {int32_t(get(i * 12)), get(i * 12 + 4), get(i * 12 + 8)};
+    }
+    return syms;
+}
+
+} // namespace riblt
+} // namespace syncps
+
+#endif // SYNCPS_RIBLT_HPP
@@ -20,12 +20,16 @@
 #ifndef SYNCPS_SYNCPS_HPP
 #define SYNCPS_SYNCPS_HPP
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <functional>
 #include <limits>
 #include <map>
+#include <optional>
 #include <random>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <ndn-cxx/face.hpp>
 #include <ndn-cxx/security/key-chain.hpp>
@@ -36,6 +40,8 @@
 #include <ndn-cxx/util/time.hpp>
 
 #include "syncps/iblt.hpp"
+#include "syncps/recorder.hpp"
+#include "syncps/riblt.hpp"
 
 namespace syncps
 {
@@ -48,11 +54,40 @@ using ScopedEventId = ndn::scheduler::ScopedEventId; // scheduler events
 
 namespace tlv
 {
-    enum { syncpsContent = 129 }; // tlv for block of publications
+    enum {
+        syncpsContent = 129,    // tlv for block of publications
+        syncpsMore = 130        // (empty) reply asking for more rateless iblt symbols
+    };
 } // namespace tlv
 
 constexpr int maxPubSize = 1300;    // max payload in Data (approximate)
 
+/**
+ * @brief sync protocol versions
+ *
+ * The version sets the form of the sync interests we send. Peers answer
+ * interests of either version so versions can be mixed in a sync group.
+ *
+ *   iblt   /<sync-prefix>/<IBLT> where the IBLT has a fixed size so it
+ *          can't be decoded if the difference between peers is too big
+ *   riblt  /<sync-prefix>/riblt/<token>/<first>/<symbols> where the symbols
+ *          are a batch of the rateless IBLT of our set (see riblt.hpp)
+ *          starting at the 'first'th. A peer decodes the batches of a
+ *          session ('token') as they arrive and, if it can't decode the
+ *          difference yet and has nothing to send, replies with an empty
+ *          syncpsMore Data. We then continue the session with the next
+ *          batch, twice the size of the last, so the number of rounds
+ *          grows with the log of the difference and the symbols with the
+ *          difference itself.
+ */
+enum class SyncProto { iblt, riblt };
+
+const ndn::name::Component ribltMarker{"riblt"};
+constexpr size_t ribltFirstBatch = 16;      // symbols in a session's first interest
+constexpr size_t ribltMaxBatch = 600;       // symbols that fit in an interest
+constexpr size_t ribltMaxSymbols = 1 << 15; // session gives up (~24k difference)
+constexpr size_t ribltMaxSessions = 64;     // peer sessions we'll decode at once
+
 using namespace ndn::literals::time_literals;
 constexpr ndn::time::milliseconds maxPubLifetime = 1_s;
 constexpr ndn::time::milliseconds maxClockSkew = 1_s;
@@ -62,17 +97,82 @@ constexpr ndn::time::milliseconds maxClockSkew = 1_s;
  */
 using UpdateCb = std::function<void(const Publication&)>;
 
+/**
+ * @brief a publication in the active set
+ *
+ * Pubs from peers are held as their wire encoding and name. The rest of
+ * the Publication (meta info, content, signature) is only decoded if it's
+ * asked for (e.g., to deliver it to a subscription) so pubs that are just
+ * stored and relayed for others are never fully decoded.
+ */
+class LazyPub
+{
+  public:
+    explicit LazyPub(Publication&& pub)
+        : m_wire{pub.wireEncode()}, m_name{pub.getName()}, m_pub{std::move(pub)} {}
+
+    // decodes just the name (throws ndn::tlv::Error if 'wire' is malformed)
+    explicit LazyPub(const ndn::Block& wire) : m_wire{wire}
+    {
+        m_wire.parse();
+        m_name.wireDecode(m_wire.get(ndn::tlv::Name));
+    }
+
+    const Name& getName() const { return m_name; }
+    const ndn::Block& wireEncode() const { return m_wire; }
+
+    const Publication& pub() const
+    {
+        if (! m_pub) {
+            m_pub.emplace(m_wire);
+        }
+        return *m_pub;
+    }
+
+  private:
+    ndn::Block m_wire;
+    Name m_name{};
+    mutable std::optional<Publication> m_pub{};
+};
+
 /**
  * @brief app callback to test if publication is expired
  */
-using IsExpiredCb = std::function<bool(const Publication&)>;
+using IsExpiredCb = std::function<bool(const LazyPub&)>;
 /**
  * @brief app callback to filter peer publication requests
  */
-using PubPtr = std::shared_ptr<const Publication>;
+using PubPtr = std::shared_ptr<const LazyPub>;
 using VPubPtr = std::vector<PubPtr>;
 using FilterPubsCb = std::function<VPubPtr(VPubPtr&,VPubPtr&)>;
 
+/**
+ * @brief sync counters and sizes
+ *
+ * These are updated (with relaxed atomics) by the face thread and
+ * can be read from any thread, e.g., by a metrics exporter.
+ */
+struct SyncStats {
+    using Count = std::atomic<uint64_t>;
+    Count interestsSent{};
+    Count interestsRcvd{};
+    Count dataSent{};
+    Count dataRcvd{};
+    Count pubsPublished{};  // local publications
+    Count pubsRcvd{};       // new publications from peers
+    Count pubsDelivered{};  // new publications delivered to a subscription
+    Count pubsKnown{};      // arriving pubs skipped as already known
+    Count dataSkipped{};    // sync Data not validated since all its pubs were known
+    Count decodeFails{};
+    Count moreSent{};       // requests for more rateless iblt symbols sent
+    Count symbolsSent{};    // rateless iblt symbols sent
+    Count nacks{};
+    Count timeouts{};
+    std::atomic<int64_t> activePubs{};
+    std::atomic<int64_t> pendingInterests{};
+    std::atomic<int64_t> subscriptions{};
+};
+
 /**
  * @brief sync a lifetime-bounded set of publications among
  *        an arbitrary set of nodes.
@@ -140,21 +240,63 @@ class SyncPubsub
     SyncPubsub& publish(Publication&& pub)
     {
         m_keyChain.sign(pub, m_signingInfo); //XXX
-        if (isKnown(pub)) {
+        auto hash = hashPub(pub);
+        if (isKnown(hash)) {
             NDN_LOG_WARN("republish of '" << pub.getName() << "' ignored");
         } else {
             NDN_LOG_INFO("Publish: " << pub.getName());
             ++m_publications;
-            addToActive(std::move(pub), true);
+            inc(m_stats.pubsPublished);
+            addToActive(LazyPub(std::move(pub)), hash, true);
             // new pub may let us respond to pending interest(s).
             if (! m_delivering) {
                 sendSyncInterest();
-                handleInterests();
+                answerPending({hash});
+            } else {
+                m_newLocal.push_back(hash);
             }
         }
         return *this;
     }
 
+    /**
+     * @brief publish a batch of new publications from app
+     *
+     * Like calling publish() on each but the sync interest carrying the
+     * new iblt is sent and pending peer interests are answered once for
+     * the whole batch rather than once per publication.
+     *
+     * @param pubs the objects to publish
+     */
+    SyncPubsub& publishMany(std::vector<Publication>&& pubs)
+    {
+        std::vector<uint32_t> added;
+        added.reserve(pubs.size());
+        for (auto& pub : pubs) {
+            m_keyChain.sign(pub, m_signingInfo); //XXX
+            auto hash = hashPub(pub);
+            if (isKnown(hash)) {
+                NDN_LOG_WARN("republish of '" << pub.getName() << "' ignored");
+                continue;
+            }
+            NDN_LOG_INFO("Publish: " << pub.getName());
+            ++m_publications;
+            inc(m_stats.pubsPublished);
+            addToActive(LazyPub(std::move(pub)), hash, true);
+            added.push_back(hash);
+        }
+        if (added.empty()) {
+            return *this;
+        }
+        if (! m_delivering) {
+            sendSyncInterest();
+            answerPending(added);
+        } else {
+            m_newLocal.insert(m_newLocal.end(), added.begin(), added.end());
+        }
+        return *this;
+    }
+
     /**
      * @brief subscribe to a subtopic
      *
@@ -168,6 +310,7 @@ class SyncPubsub
         // add to subscription dispatch table. NOTE that an existing
         // subscription to 'topic' will be changed to the new callback.
         m_subscription[topic] = std::move(cb);
+        m_stats.subscriptions.store(m_subscription.size(), std::memory_order_relaxed);
         NDN_LOG_INFO("subscribeTo: " << topic);
         return *this;
     }
@@ -182,6 +325,7 @@ class SyncPubsub
     SyncPubsub& unsubscribe(const Name& topic)
     {
         m_subscription.erase(topic);
+        m_stats.subscriptions.store(m_subscription.size(), std::memory_order_relaxed);
         NDN_LOG_INFO("unsubscribe: " << topic);
         return *this;
     }
@@ -197,6 +341,19 @@ class SyncPubsub
         return *this;
     }
 
+    /**
+     * @brief set the protocol version of the sync interests we send
+     *
+     * Takes effect with our next sync interest.
+     *
+     * @param p protocol version (see SyncProto)
+     */
+    SyncPubsub& setSyncProto(SyncProto p)
+    {
+        m_proto = p;
+        return *this;
+    }
+
     /**
      * @brief schedule a callback after some time
      *
@@ -246,6 +403,16 @@ class SyncPubsub
 
     const ndn::security::v2::Validator& getValidator() { return m_validator; }
 
+    /**
+     * @brief this instance's flight recorder of recent sync events
+     */
+    const FlightRecorder& recorder() const { return m_recorder; }
+
+    /**
+     * @brief this instance's counters
+     */
+    const SyncStats& stats() const { return m_stats; }
+
    private:
 
     /**
@@ -267,6 +434,7 @@ class SyncPubsub
      *        to our peers.
      *
      * Creates & sends interest of the form: /<sync-prefix>/<own-IBF>
+     * (or, for SyncProto::riblt, the first interest of a new session)
      */
     void sendSyncInterest()
     {
@@ -275,13 +443,60 @@ class SyncPubsub
         if (m_registering) {
             return;
         }
-        // schedule the next send
-        reExpressSyncInterest();
-
         // Build and ship the interest. Format is
         // /<sync-prefix>/<ourLatestIBF>
         ndn::Name name = m_syncPrefix;
-        m_iblt.appendToName(name);
+        if (m_proto == SyncProto::riblt) {
+            // the session's symbols all come from a snapshot of our set
+            riblt::Encoder enc;
+            for (const auto k : m_keys) {
+                enc.add(k);
+            }
+            m_session.emplace(RibltSession{ndn::random::generateWord32(), std::move(enc),
+                                           ribltFirstBatch});
+            appendSymbols(name);
+        } else {
+            m_session.reset();
+            m_iblt.appendToName(name);
+        }
+        expressSyncInterest(name);
+    }
+
+    /**
+     * @brief continue our rateless iblt session with its next batch of
+     *        symbols (a peer couldn't decode the ones it has)
+     */
+    void sendMoreSymbols()
+    {
+        if (m_session->enc.produced() >= ribltMaxSymbols) {
+            // difference is too big to ever decode: start over
+            inc(m_stats.decodeFails);
+            m_recorder.record(SyncEv::decodeFail, m_session->token, failIBLT);
+            sendSyncInterest();
+            return;
+        }
+        m_session->batch = std::min(m_session->batch * 2, ribltMaxBatch);
+        ndn::Name name = m_syncPrefix;
+        appendSymbols(name);
+        expressSyncInterest(name);
+    }
+
+    // append riblt/<token>/<first>/<symbols> for our session's next batch
+    void appendSymbols(ndn::Name& name)
+    {
+        auto& s = *m_session;
+        name.append(ribltMarker).appendNumber(s.token).appendNumber(s.enc.produced());
+        riblt::appendToName(name, s.enc.next(s.batch));
+        m_stats.symbolsSent.fetch_add(s.batch, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief express sync interest 'name' as our current sync interest
+     */
+    void expressSyncInterest(const ndn::Name& name)
+    {
+        // schedule the next send
+        reExpressSyncInterest();
 
         ndn::Interest syncInterest(name);
         m_currentInterest = ndn::random::generateWord32();
@@ -289,16 +504,31 @@ class SyncPubsub
             .setCanBePrefix(true)
             .setMustBeFresh(true)
             .setInterestLifetime(m_syncInterestLifetime);
+        auto ih = hashIBLT(name);
         m_face.expressInterest(syncInterest,
                 [this](auto i, auto d) {
+                    if (allKnown(i, d)) {
+                        return;
+                    }
                     m_validator.validate(d,
                         [this, i](auto d) { onValidData(i, d); },
-                        [](auto d, auto e) { NDN_LOG_INFO("Invalid: " << e << " Data " << d); }); },
-                [](auto i, auto/*n*/) { NDN_LOG_INFO("Nack for " << i); },
-                [](auto i) { NDN_LOG_INFO("Timeout for " << i); });
-        ++m_interestsSent;
+                        [this](auto d, auto e) {
+                            inc(m_stats.decodeFails);
+                            m_recorder.record(SyncEv::decodeFail, hashIBLT(d.getName()),
+                                              failValidate);
+                            NDN_LOG_INFO("Invalid: " << e << " Data " << d); }); },
+                [this, ih](auto i, auto/*n*/) {
+                    inc(m_stats.nacks);
+                    m_recorder.record(SyncEv::nack, ih);
+                    NDN_LOG_INFO("Nack for " << i); },
+                [this, ih](auto i) {
+                    inc(m_stats.timeouts);
+                    m_recorder.record(SyncEv::timeout, ih);
+                    NDN_LOG_INFO("Timeout for " << i); });
+        inc(m_stats.interestsSent);
+        m_recorder.record(SyncEv::interestSent, ih, m_active.size());
         NDN_LOG_DEBUG("sendSyncInterest " << std::hex
-                      << m_currentInterest << "/" << hashIBLT(name));
+                      << m_currentInterest << "/" << ih);
     }
 
     /**
@@ -328,54 +558,176 @@ class SyncPubsub
             return;
         }
         const ndn::Name& name = interest.getName();
+        inc(m_stats.interestsRcvd);
+        m_recorder.record(SyncEv::interestRcvd, hashIBLT(name));
         NDN_LOG_DEBUG("onSyncInterest " << std::hex << interest.getNonce() << "/"
                       << hashIBLT(name));
 
-        if (name.size() - prefixName.size() != 1) {
+        auto ncomp = name.size() - prefixName.size();
+        bool rateless = ncomp == 4 && name[prefixName.size()] == ribltMarker;
+        if (ncomp != 1 && ! rateless) {
             NDN_LOG_INFO("invalid sync interest: " << interest);
             return;
         }
-        if (!  handleInterest(name)) {
-            // couldn't handle interest immediately - remember it until
-            // we satisfy it or it times out;
-            m_interests[name] = ndn::time::system_clock::now() +
-                                    m_syncInterestLifetime;
+        auto ih = hashIBLT(name);
+        std::vector<uint32_t> have;
+        bool decoded = true;
+        if (! (rateless? peelRateless(name, prefixName.size(), ih, have, decoded)
+                       : peel(name, ih, have)) || sendPubs(name, ih, have)) {
+            return;
+        }
+        if (! decoded) {
+            // nothing to send yet but more symbols may show we have something
+            inc(m_stats.moreSent);
+            sendSyncData(name, ndn::encoding::makeEmptyBlock(tlv::syncpsMore));
+            return;
         }
+        // couldn't handle interest immediately - remember it (and what
+        // it lacks) until we satisfy it or it times out.
+        m_interests[name] = {ndn::time::system_clock::now() + m_syncInterestLifetime,
+                             ih, std::move(have)};
+        m_stats.pendingInterests.store(m_interests.size(), std::memory_order_relaxed);
     }
 
-    void handleInterests()
+    /**
+     * @brief answer pending interests given new local publications
+     *
+     * New pubs can't be in any pending interest's iblt so they're added to
+     * the pubs each interest was missing when it arrived and the interest is
+     * answered from that without decoding or peeling it again. (Pubs from
+     * other peers that arrived since then go out in answer to the peer's
+     * next interest.)
+     *
+     * @param added hashes of the new publications
+     */
+    void answerPending(const std::vector<uint32_t>& added)
     {
-        NDN_LOG_DEBUG("handleInterests");
+        NDN_LOG_DEBUG("answerPending");
         auto now = ndn::time::system_clock::now();
         for (auto i = m_interests.begin(); i != m_interests.end(); ) {
-            const auto& [name, expires] = *i;
-            if (expires <= now || handleInterest(name)) {
-                i = m_interests.erase(i);
-            } else {
-                ++i;
+            auto& [name, pi] = *i;
+            if (pi.expires > now) {
+                pi.have.insert(pi.have.end(), added.begin(), added.end());
+                if (! sendPubs(name, pi.ih, pi.have)) {
+                    ++i;
+                    continue;
+                }
             }
+            i = m_interests.erase(i);
         }
+        m_stats.pendingInterests.store(m_interests.size(), std::memory_order_relaxed);
     }
 
-    bool handleInterest(const ndn::Name& name)
+    /**
+     * @brief peel the difference between a peer's iblt (in sync interest
+     *        'name') and ours
+     *
+     * Gives two sets:
+     *   have - (hashes of) items we have that they don't
+     *   need - (hashes of) items we need that they have
+     *
+     * @return false if the interest's iblt couldn't be decoded
+     */
+    bool peel(const ndn::Name& name, uint32_t ih, std::vector<uint32_t>& have)
     {
-        // 'Peeling' the difference between the peer's iblt & ours gives
-        // two sets:
-        //   have - (hashes of) items we have that they don't
-        //   need - (hashes of) items we need that they have
         IBLT iblt(m_expectedNumEntries);
         try {
             iblt.initialize(name.get(-1));
         } catch (const std::exception& e) {
+            inc(m_stats.decodeFails);
+            m_recorder.record(SyncEv::decodeFail, ih, failIBLT);
             NDN_LOG_WARN(e.what());
-            return true;
+            return false;
         }
-        std::set<uint32_t> have;
+        std::set<uint32_t> hv;
         std::set<uint32_t> need;
-        (m_iblt - iblt).listEntries(have, need);
-        NDN_LOG_DEBUG("handleInterest " << std::hex << hashIBLT(name)
-                      << " need " << need.size() << ", have " << have.size());
+        (m_iblt - iblt).listEntries(hv, need);
+        m_recorder.record(SyncEv::interestPeeled, ih, hv.size(), need.size());
+        NDN_LOG_DEBUG("peel " << std::hex << ih
+                      << " need " << need.size() << ", have " << hv.size());
+        have.assign(hv.begin(), hv.end());
+        return true;
+    }
+
+    /**
+     * @brief add the symbols in rateless sync interest 'name' to the
+     *        decoding of its session and peel what we can
+     *
+     * Sets 'have' to (hashes of) the items found so far that we have and
+     * they don't and 'decoded' to whether the difference was completely
+     * decoded. A session is started by its first interest and its state
+     * kept until it expires so a continuation whose session we don't have
+     * (it started with another peer or we missed some of it) is ignored.
+     *
+     * @return false if the interest's symbols couldn't be used
+     */
+    bool peelRateless(const ndn::Name& name, size_t psize, uint32_t ih,
+                      std::vector<uint32_t>& have, bool& decoded)
+    {
+        uint64_t token, first;
+        std::vector<riblt::Symbol> syms;
+        try {
+            token = name[psize + 1].toNumber();
+            first = name[psize + 2].toNumber();
+            syms = riblt::fromComponent(name[psize + 3]);
+        } catch (const std::exception& e) {
+            inc(m_stats.decodeFails);
+            m_recorder.record(SyncEv::decodeFail, ih, failIBLT);
+            NDN_LOG_WARN(e.what());
+            return false;
+        }
+        auto now = ndn::time::system_clock::now();
+        auto s = m_peerSessions.find(token);
+        if (first == 0) {
+            pruneSessions(now);
+            riblt::Encoder ours;
+            for (const auto k : m_keys) {
+                ours.add(k);
+            }
+            s = m_peerSessions.insert_or_assign(token,
+                    PeerSession{riblt::Decoder(std::move(ours)),
+                                now + m_syncInterestLifetime * 2}).first;
+        } else if (s == m_peerSessions.end() || s->second.dec.size() != first) {
+            NDN_LOG_DEBUG("no session for " << std::hex << token << std::dec << " at " << first);
+            return false;
+        }
+        auto& dec = s->second.dec;
+        dec.add(syms);
+        decoded = dec.decode();
+        m_recorder.record(SyncEv::interestPeeled, ih, dec.ours().size(), dec.theirs().size());
+        NDN_LOG_DEBUG("peelRateless " << std::hex << ih << std::dec << " symbols " << dec.size()
+                      << (decoded? " decoded" : "") << " need " << dec.theirs().size()
+                      << ", have " << dec.ours().size());
+        if (! decoded && dec.size() >= ribltMaxSymbols) {
+            inc(m_stats.decodeFails);
+            m_recorder.record(SyncEv::decodeFail, ih, failIBLT);
+            m_peerSessions.erase(s);
+            return false;
+        }
+        have = dec.ours();
+        return true;
+    }
 
+    // drop expired peer sessions and, if there are still too many, the
+    // one that expires first
+    void pruneSessions(ndn::time::system_clock::TimePoint now)
+    {
+        for (auto i = m_peerSessions.begin(); i != m_peerSessions.end(); ) {
+            i = i->second.expires <= now? m_peerSessions.erase(i) : std::next(i);
+        }
+        if (m_peerSessions.size() >= ribltMaxSessions) {
+            m_peerSessions.erase(std::min_element(m_peerSessions.begin(), m_peerSessions.end(),
+                    [](const auto& a, const auto& b) { return a.second.expires < b.second.expires; }));
+        }
+    }
+
+    /**
+     * @brief answer sync interest 'name' with the active pubs among 'have'
+     *
+     * @return false if there was nothing (that filterPubs allows) to send
+     */
+    bool sendPubs(const ndn::Name& name, uint32_t ih, const std::vector<uint32_t>& have)
+    {
         // If we have things the other side doesn't, send as many as
         // will fit in one Data. Make two lists of needed, active publications:
         // ones we published and ones published by others.
@@ -404,6 +756,8 @@ class SyncPubsub
             }
         }
         pubs.encode();
+        inc(m_stats.dataSent);
+        m_recorder.record(SyncEv::dataSent, ih, pubs.elements_size());
         sendSyncData(name, pubs);
         return true;
     }
@@ -427,6 +781,49 @@ class SyncPubsub
         m_face.put(*data);
     }
 
+    /**
+     * @brief check if sync data only carries pubs we already have
+     *
+     * Several peers often answer the same interest with the same pubs.
+     * The hashes of the Data's pubs (which are over their wire encoding)
+     * are checked against the active set before the Data is validated and
+     * if all are known, the Data is done with: validation and decoding are
+     * skipped. Malformed or empty Data returns false so it takes the
+     * normal path (and an unvalidated empty Data can't prompt a new sync
+     * interest).
+     */
+    bool allKnown(const ndn::Interest& interest, const ndn::Data& data)
+    {
+        size_t npubs{};
+        try {
+            const ndn::Block& pubs(data.getContent().blockFromValue());
+            if (pubs.type() != tlv::syncpsContent) {
+                return false;
+            }
+            pubs.parse();
+            for (const auto& e : pubs.elements()) {
+                if (e.type() != ndn::tlv::Data || ! isKnown(hashWire(e))) {
+                    return false;
+                }
+                ++npubs;
+            }
+        } catch (const std::exception&) {
+            return false;
+        }
+        if (npubs == 0) {
+            return false;
+        }
+        NDN_LOG_DEBUG("all " << npubs << " pubs known in " << data.getName());
+        inc(m_stats.dataRcvd);
+        inc(m_stats.dataSkipped);
+        m_stats.pubsKnown.fetch_add(npubs, std::memory_order_relaxed);
+        m_recorder.record(SyncEv::dataRcvd, hashIBLT(interest.getName()), npubs, 0);
+        if (interest.getNonce() == m_currentInterest) {
+            sendSyncInterest();
+        }
+        return true;
+    }
+
     /**
      * @brief Process sync data after successful validation
      *
@@ -444,7 +841,17 @@ class SyncPubsub
                        << " " << data.getName());
 
         const ndn::Block& pubs(data.getContent().blockFromValue());
+        auto ih = hashIBLT(interest.getName());
+        if (pubs.type() == tlv::syncpsMore) {
+            // a peer needs more of our session's symbols
+            if (interest.getNonce() == m_currentInterest && m_session) {
+                sendMoreSymbols();
+            }
+            return;
+        }
         if (pubs.type() != tlv::syncpsContent) {
+            inc(m_stats.decodeFails);
+            m_recorder.record(SyncEv::decodeFail, ih, failContentType);
             NDN_LOG_WARN("Sync Data with wrong content type " <<
                          pubs.type() << " ignored.");
             return;
@@ -453,19 +860,38 @@ class SyncPubsub
         // if publications result from handling this data we don't want to
         // respond to a peer's interest until we've handled all of them.
         m_delivering = true;
-        auto initpubs = m_publications;
+        size_t npubs{}, nnew{};
 
         pubs.parse();
         for (const auto& e : pubs.elements()) {
+            ++npubs;
             if (e.type() != ndn::tlv::Data) {
+                inc(m_stats.decodeFails);
+                m_recorder.record(SyncEv::decodeFail, ih, failPubType);
                 NDN_LOG_WARN("Sync Data with wrong Publication type " <<
                              e.type() << " ignored.");
                 continue;
             }
             //XXX validate pub against schema here
-            Publication pub(e);
-            if (m_isExpired(pub) || isKnown(pub)) {
-                NDN_LOG_DEBUG("ignore expired or known " << pub.getName());
+            // (a pub's hash is over its wire encoding so known pubs are
+            // skipped without decoding anything. The rest just have their
+            // name decoded and share 'e's wire buffer.)
+            auto hash = hashWire(e);
+            if (isKnown(hash)) {
+                inc(m_stats.pubsKnown);
+                continue;
+            }
+            std::optional<LazyPub> pub;
+            try {
+                pub.emplace(e);
+            } catch (const std::exception& ex) {
+                inc(m_stats.decodeFails);
+                m_recorder.record(SyncEv::decodeFail, ih, failPubType);
+                NDN_LOG_WARN("undecodable Publication ignored: " << ex.what());
+                continue;
+            }
+            if (m_isExpired(*pub)) {
+                NDN_LOG_DEBUG("ignore expired " << pub->getName());
                 continue;
             }
             // we don't already have this publication so deliver it
@@ -476,13 +902,15 @@ class SyncPubsub
             // Also, it would be faster to do the comparison on the
             // wire-format names (excluding the leading length value)
             // rather than default of component-by-component.
-            const auto& p = addToActive(std::move(pub));
+            const auto& p = addToActive(std::move(*pub), hash);
+            ++nnew;
             const auto& nm = p->getName();
             auto sub = m_subscription.lower_bound(nm);
             if ((sub != m_subscription.end() && sub->first.isPrefixOf(nm)) ||
                 (sub != m_subscription.begin() && (--sub)->first.isPrefixOf(nm))) {
                 NDN_LOG_DEBUG("deliver " << nm << " to " << sub->first);
-                sub->second(*p);
+                inc(m_stats.pubsDelivered);
+                sub->second(p->pub());
             } else {
                 NDN_LOG_DEBUG("no sub for  " << nm);
             }
@@ -494,11 +922,15 @@ class SyncPubsub
         // If deliveries resulted in new publications, try to satisfy
         // pending peer interests.
         m_delivering = false;
+        inc(m_stats.dataRcvd);
+        m_stats.pubsRcvd.fetch_add(nnew, std::memory_order_relaxed);
+        m_recorder.record(SyncEv::dataRcvd, ih, npubs, nnew);
         if (interest.getNonce() == m_currentInterest) {
             sendSyncInterest();
         }
-        if (initpubs != m_publications) {
-            handleInterests();
+        if (! m_newLocal.empty()) {
+            answerPending(m_newLocal);
+            m_newLocal.clear();
         }
     }
 
@@ -509,13 +941,13 @@ class SyncPubsub
     // publications are stored using a shared_ptr so we
     // get to them indirectly via their hash.
 
-    uint32_t hashPub(const Publication& pub) const
+    uint32_t hashWire(const ndn::Block& b) const
     {
-        const auto& b = pub.wireEncode();
-        return murmurHash3(N_HASHCHECK,
-                           std::vector<uint8_t>(b.wire(), b.wire() + b.size()));
+        return murmurHash3(N_HASHCHECK, b.wire(), b.size());
     }
 
+    uint32_t hashPub(const Publication& pub) const { return hashWire(pub.wireEncode()); }
+
     bool isKnown(uint32_t h) const
     {
         //return m_hash2pub.contains(h);
@@ -529,14 +961,16 @@ class SyncPubsub
         return isKnown(hashPub(pub));
     }
 
-    std::shared_ptr<Publication> addToActive(Publication&& pub, bool localPub = false)
+    PubPtr addToActive(LazyPub&& pub, uint32_t hash, bool localPub = false)
     {
         NDN_LOG_DEBUG("addToActive: " << pub.getName());
-        auto hash = hashPub(pub);
-        auto p = std::make_shared<Publication>(pub);
+        PubPtr p = std::make_shared<const LazyPub>(std::move(pub));
         m_active[p] = localPub? 3 : 1;
         m_hash2pub[hash] = p;
         m_iblt.insert(hash);
+        m_keys.insert(hash);
+        m_recorder.record(SyncEv::pubAdded, hash, localPub);
+        m_stats.activePubs.store(m_active.size(), std::memory_order_relaxed);
 
         // We remove an expired publication from our active set at twice its pub
         // lifetime (the extra time is to prevent replay attacks enabled by clock
@@ -550,7 +984,12 @@ class SyncPubsub
 
         m_scheduler.schedule(maxPubLifetime, [this, p] { m_active[p] &=~ 1U; });
         m_scheduler.schedule(maxPubLifetime + maxClockSkew,
-            [this, hash] { m_iblt.erase(hash); sendSyncInterestSoon(); });
+            [this, hash] {
+                m_recorder.record(SyncEv::pubExpired, hash);
+                m_iblt.erase(hash);
+                m_keys.erase(hash);
+                sendSyncInterestSoon();
+            });
         m_scheduler.schedule(maxPubLifetime * 2, [this, p] { removeFromActive(p); });
 
         return p;
@@ -560,7 +999,8 @@ class SyncPubsub
     {
         NDN_LOG_DEBUG("removeFromActive: " << (*p).getName());
         m_active.erase(p);
-        m_hash2pub.erase(hashPub(*p));
+        m_hash2pub.erase(hashWire(p->wireEncode()));
+        m_stats.activePubs.store(m_active.size(), std::memory_order_relaxed);
     }
 
     /**
@@ -575,11 +1015,12 @@ class SyncPubsub
         BOOST_THROW_EXCEPTION(Error(msg));
     }
 
+    static void inc(SyncStats::Count& c) { c.fetch_add(1, std::memory_order_relaxed); }
+
     uint32_t hashIBLT(const Name& n) const
     {
         const auto& b = n[-1];
-        return murmurHash3(N_HASHCHECK,
-                           std::vector<uint8_t>(b.value_begin(), b.value_end()));
+        return murmurHash3(N_HASHCHECK, b.value(), b.value_size());
     }
 
   private:
@@ -588,13 +1029,31 @@ class SyncPubsub
     uint32_t m_expectedNumEntries;
     ndn::security::v2::Validator& m_validator;
     ndn::Scheduler m_scheduler;
-    std::map<const Name, ndn::time::system_clock::TimePoint> m_interests{};
+    struct PendingInterest {
+        ndn::time::system_clock::TimePoint expires;
+        uint32_t ih;                    // hash of its iblt
+        std::vector<uint32_t> have;     // (hashes of) pubs it lacks that we have
+    };
+    std::map<const Name, PendingInterest> m_interests{};
     IBLT m_iblt;
+    std::unordered_set<uint32_t> m_keys{};  // hashes in m_iblt (encoded by riblt)
+    SyncProto m_proto{SyncProto::iblt};
+    struct RibltSession {               // our rateless session
+        uint32_t token;
+        riblt::Encoder enc;             // snapshot of our set at its start
+        size_t batch;                   // symbols in its last interest
+    };
+    std::optional<RibltSession> m_session{};
+    struct PeerSession {                // a peer's rateless session
+        riblt::Decoder dec;
+        ndn::time::system_clock::TimePoint expires;
+    };
+    std::unordered_map<uint64_t, PeerSession> m_peerSessions{};
     ndn::KeyChain m_keyChain;
     SigningInfo m_signingInfo;
     // currently active published items
-    std::unordered_map<std::shared_ptr<const Publication>, uint8_t> m_active{};
-    std::unordered_map<uint32_t, std::shared_ptr<const Publication>> m_hash2pub{};
+    std::unordered_map<PubPtr, uint8_t> m_active{};
+    std::unordered_map<uint32_t, PubPtr> m_hash2pub{};
     std::map<const Name, UpdateCb> m_subscription{};
     IsExpiredCb m_isExpired;
     FilterPubsCb m_filterPubs;
@@ -604,8 +1063,10 @@ class SyncPubsub
     ndn::ScopedRegisteredPrefixHandle m_registeredPrefix;
     uint32_t m_currentInterest{};   // nonce of current sync interest
     uint32_t m_publications{};      // # local publications
-    uint32_t m_interestsSent{};
+    SyncStats m_stats{};
+    FlightRecorder m_recorder{};
     bool m_delivering{false};       // currently processing a Data
+    std::vector<uint32_t> m_newLocal{}; // pubs published while delivering
     bool m_registering{true};
 };
 
@@ -0,0 +1,377 @@
+#ifndef TPUT_HPP
+#define TPUT_HPP
+/*
+ * tput.hpp: NDN goodput measurement between NODs
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * A TputServer answers Interests for <prefix>/<size>/<seq> with generated
+ * Data carrying 'size' bytes of content (signed with a SHA256 digest so
+ * signing costs little). A TputClient pulls <prefix>/<size>/<seq> with a
+ * fixed window of pipelined Interests for a given duration, retransmitting
+ * on timeout or Nack, then reports goodput, RTT percentiles (from Data that
+ * weren't retransmitted) and its retransmissions.
+ *
+ * A SizeSweep also pulls from a TputServer but one Interest at a time (so
+ * the path is unloaded) for 'count' Data of each of a list of content sizes
+ * and reports loss and RTT by size. The largest size that, like all smaller
+ * ones, saw no loss is the largest safe payload for the path.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ndn-cxx/face.hpp>
+#include <ndn-cxx/security/key-chain.hpp>
+#include <ndn-cxx/security/signing-helpers.hpp>
+
+class TputServer
+{
+  public:
+    static constexpr size_t maxSize = 8000;     // content bytes per Data
+
+    using RegCb = std::function<void(bool ok)>;
+
+    TputServer(ndn::Face& face, const ndn::Name& prefix)
+        : m_face{face}, m_prefix{prefix}, m_payload(maxSize, 'x') {}
+
+    // register the prefix then call 'cb' with whether that worked
+    void start(RegCb&& cb)
+    {
+        m_reg = m_face.setInterestFilter(
+                    ndn::InterestFilter(m_prefix).allowLoopback(false),
+                    [this](auto&, const auto& i) {
+                        // (Interests not named as below are dropped)
+                        if (wellFormed(i.getName())) {
+                            m_face.put(make(i));
+                        }
+                    },
+                    [cb](auto&) { cb(true); },
+                    [cb](auto&, auto&) { cb(false); },
+                    ndn::security::signingWithSha256());
+    }
+
+    // true if 'n' is <prefix>/<size>/<seq>
+    bool wellFormed(const ndn::Name& n) const
+    {
+        return n.size() == m_prefix.size() + 2 && n[m_prefix.size()].isNumber();
+    }
+
+    // the Data for well-formed Interest 'i'
+    ndn::Data make(const ndn::Interest& i)
+    {
+        const auto& n = i.getName();
+        size_t size = std::min<size_t>(n[m_prefix.size()].toNumber(), maxSize);
+        ndn::Data d(n);
+        d.setContent((const uint8_t*)m_payload.data(), size);
+        d.setFreshnessPeriod(ndn::time::milliseconds(0));
+        m_keyChain.sign(d, ndn::security::signingWithSha256());
+        ++m_served;
+        return d;
+    }
+
+    const ndn::Name& prefix() const { return m_prefix; }
+    uint64_t served() const { return m_served; }
+
+  private:
+    ndn::Face& m_face;
+    ndn::Name m_prefix;
+    std::string m_payload;
+    ndn::KeyChain m_keyChain{"pib-memory:", "tpm-memory:"};
+    ndn::ScopedRegisteredPrefixHandle m_reg{};
+    uint64_t m_served{};
+};
+
+class TputClient
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct Params {
+        size_t size{4096};                              // content bytes per Data
+        std::chrono::milliseconds duration{5000};       // time to send new Interests
+        uint32_t window{16};                            // Interests in flight
+        std::chrono::milliseconds lifetime{1000};       // of each Interest
+        uint32_t maxRetx{3};                            // per Data
+    };
+
+    struct Result {
+        double secs{};
+        uint64_t bytes{};
+        uint64_t data{};
+        uint64_t retx{};
+        uint64_t timeouts{};
+        uint64_t nacks{};
+        uint64_t failed{};      // gave up after maxRetx
+        std::vector<double> rttMs{};
+
+        double mbps() const { return secs > 0? bytes * 8e-6 / secs : 0.; }
+
+        // 'p'th percentile RTT (rttMs must be sorted)
+        double rtt(double p) const
+        {
+            return rttMs.empty()? 0. : rttMs[std::min(size_t(p * rttMs.size()), rttMs.size() - 1)];
+        }
+
+        std::string str() const
+        {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(3)
+              << "goodput(Mbps): " << mbps() << "\n"
+              << "data: " << data << " bytes " << bytes << " time(s) " << secs << "\n"
+              << "rtt(ms): p50 " << rtt(.5) << " p90 " << rtt(.9) << " p99 " << rtt(.99)
+              << " max " << (rttMs.empty()? 0. : rttMs.back()) << "\n"
+              << "retx: " << retx << " timeouts " << timeouts << " nacks " << nacks
+              << " failed " << failed << "\n";
+            return s.str();
+        }
+    };
+    using Done = std::function<void(Result&&)>;
+
+    TputClient(ndn::Face& face, const ndn::Name& prefix, const Params& p, Done&& done)
+        : m_face{face}, m_prefix{ndn::Name(prefix).appendNumber(p.size)}, m_p{p},
+          m_done{std::move(done)}, m_next{std::random_device{}()} {}
+
+    void start()
+    {
+        m_start = m_last = clock::now();
+        m_end = m_start + m_p.duration;
+        m_res.rttMs.reserve(1024);
+        fill();
+    }
+
+  private:
+    struct Pending {
+        clock::time_point sent;
+        uint32_t retx;
+    };
+
+    void fill()
+    {
+        while (m_pending.size() < m_p.window && clock::now() < m_end) {
+            auto seq = m_next++;
+            m_pending[seq] = {clock::now(), 0};
+            express(seq);
+        }
+        if (m_pending.empty()) {
+            finish();
+        }
+    }
+
+    void express(uint64_t seq)
+    {
+        ndn::Interest i(ndn::Name(m_prefix).appendNumber(seq));
+        i.setCanBePrefix(false);
+        // (Data are never fresh so a repeat run can't be answered from caches)
+        i.setMustBeFresh(true);
+        i.setInterestLifetime(ndn::time::milliseconds(m_p.lifetime.count()));
+        m_face.expressInterest(i,
+                [this, seq](auto&, const auto& d) { onData(seq, d); },
+                [this, seq](auto&, auto&) { ++m_res.nacks; retry(seq); },
+                [this, seq](auto&) { ++m_res.timeouts; retry(seq); });
+    }
+
+    void onData(uint64_t seq, const ndn::Data& d)
+    {
+        auto p = m_pending.find(seq);
+        if (p == m_pending.end()) {
+            return;
+        }
+        m_last = clock::now();
+        if (p->second.retx == 0) {
+            m_res.rttMs.push_back(std::chrono::duration<double, std::milli>(m_last - p->second.sent).count());
+        }
+        ++m_res.data;
+        m_res.bytes += d.getContent().value_size();
+        m_pending.erase(p);
+        fill();
+    }
+
+    void retry(uint64_t seq)
+    {
+        auto p = m_pending.find(seq);
+        if (p == m_pending.end()) {
+            return;
+        }
+        if (p->second.retx++ < m_p.maxRetx) {
+            ++m_res.retx;
+            express(seq);
+            return;
+        }
+        ++m_res.failed;
+        m_pending.erase(p);
+        fill();
+    }
+
+    void finish()
+    {
+        if (! m_done) {
+            return;
+        }
+        m_res.secs = std::chrono::duration<double>(m_last - m_start).count();
+        std::sort(m_res.rttMs.begin(), m_res.rttMs.end());
+        // the callback may destroy this object so it must be called last
+        auto done = std::move(m_done);
+        m_done = nullptr;
+        done(std::move(m_res));
+    }
+
+    ndn::Face& m_face;
+    ndn::Name m_prefix;     // <prefix>/<size>
+    Params m_p;
+    Done m_done;
+    Result m_res{};
+    std::unordered_map<uint64_t, Pending> m_pending{};
+    uint64_t m_next;        // random start so names aren't reused across runs
+    clock::time_point m_start{};
+    clock::time_point m_end{};
+    clock::time_point m_last{};
+};
+
+class SizeSweep
+{
+  public:
+    using clock = std::chrono::steady_clock;
+
+    struct Params {
+        std::vector<size_t> sizes{256, 512, 1024, 1300, 2048, 4096, 6000, 8000};
+        uint32_t count{20};                             // Data per size
+        std::chrono::milliseconds lifetime{1000};       // of each Interest
+    };
+
+    struct SizeStats {
+        size_t size{};
+        uint32_t sent{};
+        uint32_t rcvd{};
+        double minMs{};
+        double maxMs{};
+        double sumMs{};
+    };
+    struct Result {
+        std::vector<SizeStats> sizes{};
+
+        // largest size with no loss at it or any smaller size (0 if none)
+        size_t safe() const
+        {
+            size_t s = 0;
+            for (const auto& z : sizes) {
+                if (z.rcvd < z.sent) break;
+                s = z.size;
+            }
+            return s;
+        }
+
+        std::string str() const
+        {
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(3);
+            for (const auto& z : sizes) {
+                s << "size " << z.size << " sent " << z.sent << " rcvd " << z.rcvd
+                  << " loss(%) " << (z.sent? 100. * (z.sent - z.rcvd) / z.sent : 0.)
+                  << " rtt(ms) min " << z.minMs << " avg " << (z.rcvd? z.sumMs / z.rcvd : 0.)
+                  << " max " << z.maxMs << "\n";
+            }
+            s << "largest safe payload: " << safe() << "\n";
+            return s.str();
+        }
+    };
+    using Done = std::function<void(Result&&)>;
+
+    SizeSweep(ndn::Face& face, const ndn::Name& prefix, const Params& p, Done&& done)
+        : m_face{face}, m_prefix{prefix}, m_p{p}, m_done{std::move(done)},
+          m_seq{std::random_device{}()}
+    {
+        std::sort(m_p.sizes.begin(), m_p.sizes.end());
+        m_p.sizes.erase(std::unique(m_p.sizes.begin(), m_p.sizes.end()), m_p.sizes.end());
+        m_res.sizes.reserve(m_p.sizes.size());
+    }
+
+    void start()
+    {
+        if (m_p.sizes.empty() || m_p.count == 0) {
+            finish();
+            return;
+        }
+        m_res.sizes.push_back({m_p.sizes.front()});
+        next();
+    }
+
+  private:
+    void next()
+    {
+        auto& z = m_res.sizes.back();
+        if (z.sent == m_p.count) {
+            if (m_res.sizes.size() == m_p.sizes.size()) {
+                finish();
+                return;
+            }
+            m_res.sizes.push_back({m_p.sizes[m_res.sizes.size()]});
+        }
+        auto& c = m_res.sizes.back();
+        ++c.sent;
+        ndn::Interest i(ndn::Name(m_prefix).appendNumber(c.size).appendNumber(m_seq++));
+        i.setCanBePrefix(false);
+        i.setMustBeFresh(true);
+        i.setInterestLifetime(ndn::time::milliseconds(m_p.lifetime.count()));
+        auto sent = clock::now();
+        m_face.expressInterest(i,
+                [this, sent](auto&, const auto& d) { onData(sent, d); },
+                [this](auto&, auto&) { next(); },
+                [this](auto&) { next(); });
+    }
+
+    void onData(clock::time_point sent, const ndn::Data& d)
+    {
+        auto& z = m_res.sizes.back();
+        double ms = std::chrono::duration<double, std::milli>(clock::now() - sent).count();
+        if (d.getContent().value_size() == z.size) {
+            z.minMs = z.rcvd? std::min(z.minMs, ms) : ms;
+            z.maxMs = std::max(z.maxMs, ms);
+            z.sumMs += ms;
+            ++z.rcvd;
+        }
+        next();
+    }
+
+    void finish()
+    {
+        // the callback may destroy this object so it must be called last
+        auto done = std::move(m_done);
+        done(std::move(m_res));
+    }
+
+    ndn::Face& m_face;
+    ndn::Name m_prefix;
+    Params m_p;
+    Done m_done;
+    Result m_res{};
+    uint64_t m_seq;         // random start so names aren't reused across runs
+};
+
+#endif // TPUT_HPP
@@ -0,0 +1,154 @@
+#ifndef WATCH_HPP
+#define WATCH_HPP
+/*
+ * watch.hpp: threshold conditions evaluated on a NOD
+ *
+ * Copyright (C) 2019 Pollere, Inc.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, see <https://www.gnu.org/licenses/>.
+ *  You may contact Pollere, Inc at info@pollere.net.
+ *
+ *  The DNMP proof-of-concept is not intended as production code.
+ *  More information on DNMP is available from info@pollere.net
+ */
+
+/*
+ * A Watch samples one metric every 'period' for 'duration' and evaluates a
+ * condition on it: value > threshold (or < threshold). The value can be the
+ * metric itself or its rate of change per second (for counters). The
+ * condition becomes true when the value crosses the threshold and only
+ * becomes false again once it has gone back past the threshold by the
+ * hysteresis, so a value hovering at the threshold doesn't flap.
+ *
+ * The Watch calls its Change callback only when the condition changes state
+ * (starting from false, so a condition already true at the first sample is
+ * a change) and its Done callback, with the number of changes, when its
+ * duration is up. Samples that fail (the sampler throws or returns nothing)
+ * are skipped.
+ */
+
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <sstream>
+#include <string>
+
+#include <ndn-cxx/util/scheduler.hpp>
+
+class Watch
+{
+  public:
+    using clock = std::chrono::steady_clock;
+    using Sampler = std::function<std::optional<double>()>;
+
+    struct Params {
+        bool above{true};                               // value > threshold (else <)
+        double threshold{};
+        double hysteresis{};
+        bool rate{false};                               // watch per-sec rate of change
+        std::chrono::milliseconds period{1000};
+        std::chrono::seconds duration{60};
+    };
+
+    using Change = std::function<void(bool state, double value)>;
+    using Done = std::function<void(uint32_t changes)>;
+
+    Watch(boost::asio::io_service& io, Sampler&& sample, const Params& p, Change&& change,
+          Done&& done)
+        : m_sched{io}, m_sample{std::move(sample)}, m_p{p}, m_change{std::move(change)},
+          m_done{std::move(done)} {}
+
+    void start()
+    {
+        m_end = clock::now() + m_p.duration;
+        tick();
+    }
+
+    // the condition as text, e.g., "rate > 100 (clears at 90)"
+    static std::string str(const Params& p)
+    {
+        std::ostringstream s;
+        s << (p.rate? "rate " : "") << (p.above? "> " : "< ") << p.threshold
+          << " (clears at " << (p.above? p.threshold - p.hysteresis : p.threshold + p.hysteresis)
+          << ")";
+        return s.str();
+    }
+
+  private:
+    void tick()
+    {
+        auto now = clock::now();
+        if (auto v = value(now); v) {
+            evaluate(*v);
+        }
+        if (now >= m_end) {
+            // the callback may destroy this object so it must be called last
+            auto done = std::move(m_done);
+            done(m_changes);
+            return;
+        }
+        m_timer = m_sched.schedule(ndn::time::milliseconds(m_p.period.count()), [this] { tick(); });
+    }
+
+    std::optional<double> value(clock::time_point now)
+    {
+        std::optional<double> v;
+        try {
+            v = m_sample();
+        } catch (const std::exception&) {
+            return std::nullopt;
+        }
+        if (! v || ! m_p.rate) {
+            return v;
+        }
+        // a rate needs two samples
+        auto prev = m_prev;
+        auto dt = std::chrono::duration<double>(now - m_prevTime).count();
+        m_prev = v;
+        m_prevTime = now;
+        if (! prev || dt <= 0) {
+            return std::nullopt;
+        }
+        return (*v - *prev) / dt;
+    }
+
+    void evaluate(double v)
+    {
+        bool s = m_state;
+        if (! s) {
+            s = m_p.above? v > m_p.threshold : v < m_p.threshold;
+        } else {
+            s = m_p.above? v > m_p.threshold - m_p.hysteresis : v < m_p.threshold + m_p.hysteresis;
+        }
+        if (s != m_state) {
+            m_state = s;
+            ++m_changes;
+            m_change(s, v);
+        }
+    }
+
+    ndn::Scheduler m_sched;
+    Sampler m_sample;
+    Params m_p;
+    Change m_change;
+    Done m_done;
+    bool m_state{false};
+    uint32_t m_changes{};
+    std::optional<double> m_prev{};
+    clock::time_point m_prevTime{};
+    clock::time_point m_end{};
+    ndn::scheduler::ScopedEventId m_timer{};
+};
+
+#endif // WATCH_HPP